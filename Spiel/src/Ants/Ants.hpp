@@ -99,9 +99,7 @@ public:
 	}
 
 	void create() override { 
-		for (s32 i = 0; i < 2000; i++) {
-			world.spawnAnt(Transform{ Vec2{0,0}, RotaVec2{ f32(rand() % 360) } }, 20);
-		}
+		world.spawnAnts(2000, 20);
 
 		nestui = makeUI();
 
@@ -124,9 +122,7 @@ public:
 		antcount = std::floorf(antcount);
 		if (antcount > oldAntCount) {
 			f64 diff = antcount - oldAntCount;
-			for (u32 i = 0; i < diff; i++) {
-				world.spawnAnt(Transform{ Vec2{0,0}, RotaVec2{ f32(rand() % 360) } }, 20);
-			}
+			world.spawnAnts(size_t(std::ceil(diff)), 20);
 		}
 		else if (antcount < oldAntCount) {
 			f64 diff = oldAntCount - antcount;
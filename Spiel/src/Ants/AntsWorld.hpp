@@ -53,6 +53,25 @@ public:
 		ecm.spawn(ent);
 	}
 
+	/**
+	 * Spawns count ants at the origin with random directions, the components are added in bulk.
+	 */
+	void spawnAnts(size_t count, f32 viewRange)
+	{
+		const auto ents = ecm.createMany(count);
+		ecm.addCompsWith<Transform>(ents, [](size_t i) { return Transform{ Vec2{0,0}, RotaVec2{ f32(rand() % 360) } }; });
+		ecm.addComps(ents, Collider{ Vec2{viewRange,viewRange}, Form::Circle, true }, Movement{ Vec2{1,1} }, PhysicsBody{});
+		ecm.addCompsWith<Ant>(ents, [&](size_t i) {
+			Ant ant{ .viewRange = viewRange };
+			ant.pheromoneLapTimer.getLaps(rand() % 1000 / 1000.0f);
+			ant.changeDirTimer.getLaps(rand() % 1000 / 1000.0f);
+			return ant;
+		});
+		for (auto ent : ents) {
+			ecm.spawn(ent);
+		}
+	}
+
 	void spawnBarrier(Vec2 pos, Vec2 size)
 	{
 		EntityHandle ent = ecm.create();
@@ -76,11 +95,8 @@ public:
 
 
 	EntityComponentManager<
-		ComponentStoragePagedIndexing<Transform>,
-		ComponentStoragePagedIndexing<Collider>,
+		PhysicsArchetype,
 		ComponentStoragePagedIndexing<CollisionsToken>,
-		ComponentStoragePagedIndexing<PhysicsBody>,
-		ComponentStoragePagedIndexing<Movement>,
 		ComponentStoragePagedSet<Ant>,
 		ComponentStoragePagedSet<Food>,
 		ComponentStoragePagedSet<Nest>,
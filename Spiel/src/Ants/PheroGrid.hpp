@@ -102,34 +102,27 @@ public:
 
 	void update(f32 dt)
 	{
-		std::vector<LambdaJob> fadingJobs;
-		u32 begin{ 0 };
-		u32 end{ 1000 };
-		for (; begin < pheroStrength.size(); begin += 1000) {
-			end = std::min(size_t(begin + 1000), pheroStrength.size());
-
-			fadingJobs.push_back(LambdaJob(
-				[begin, end, dt, this](u32 threadid) {
-					for (u32 i = begin; i < end; i++) {
-						auto& cell = this->pheroStrength[i];
-						if (cell < 1.0f) {
-							cell = std::clamp(cell - dt * this->strengthFade, 0.0f, MAX_CELL_OVERSATURATION);
-						}
-						else {
-							cell = std::clamp(cell - dt * this->strengthFade * 10 * MAX_CELL_OVERSATURATION, 0.0f, MAX_CELL_OVERSATURATION);
-						}
-
-						const f32 pheroDistFalloff = std::clamp(MAX_CELL_OVERSATURATION - this->strengthFade, 1.0f, MAX_CELL_OVERSATURATION);
-						this->pheroSourceTimeDist[i] += dt * this->srcDistFade * pheroDistFalloff;
-					}
+		JobSystem::parallelFor(0, pheroStrength.size(),
+			[dt, this](size_t i, u32 threadid) {
+				auto& cell = this->pheroStrength[i];
+				if (cell < 1.0f) {
+					cell = std::clamp(cell - dt * this->strengthFade, 0.0f, MAX_CELL_OVERSATURATION);
+				}
+				else {
+					cell = std::clamp(cell - dt * this->strengthFade * 10 * MAX_CELL_OVERSATURATION, 0.0f, MAX_CELL_OVERSATURATION);
 				}
-			));
-		}
-		JobSystem::wait(JobSystem::submitVec(std::move(fadingJobs)));
 
-		std::vector<LambdaJob> spreadJobs;
-		for (s32 xc = -cellsX + 1; xc <= cellsX - 1; xc++) {
-			auto jobFn = [this, xc, dt](u32 threadid) {
+				const f32 pheroDistFalloff = std::clamp(MAX_CELL_OVERSATURATION - this->strengthFade, 1.0f, MAX_CELL_OVERSATURATION);
+				this->pheroSourceTimeDist[i] += dt * this->srcDistFade * pheroDistFalloff;
+			},
+			0,
+			"pheroFade"
+		);
+
+		// one index per column, from -cellsX + 1 to cellsX - 1:
+		JobSystem::parallelFor(0, size_t(2 * cellsX - 1),
+			[this, dt](size_t column, u32 threadid) {
+				const s32 xc = s32(column) - cellsX + 1;
 				for (s32 yc = -cellsY+1; yc <= cellsY-1; yc++) {
 					f32 sum{ 0.0f };
 				
@@ -163,14 +156,10 @@ public:
 						dt* spread * (sum) +
 						(1- dt * spread) * pheroStrength[index];
 				}
-			};
-
-			spreadJobs.push_back(LambdaJob{ jobFn });
-		}
-
-		
-
-		JobSystem::wait(JobSystem::submitVec(std::move(spreadJobs)));
+			},
+			0,
+			"pheroSpread"
+		);
 
 		std::swap(pheroStrength, pheroStrengthCopy);
 	}
@@ -0,0 +1,221 @@
+#include "StorageBenchmark.hpp"
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include <memory>
+
+#include "../engine/entity/EntityComponentManager.hpp"
+#include "../engine/entity/EntityDispatch.hpp"
+
+namespace {
+
+	// component of typical size, like a Transform:
+	struct BenchComp {
+		float values[4]{ 1.0f, 2.0f, 3.0f, 4.0f };
+	};
+
+	// second component for the view over two storages:
+	struct BenchCompOther {
+		float values[2]{ 1.0f, 2.0f };
+	};
+
+	// third component that is not part of the owning group:
+	struct BenchCompExtra {
+		float value{ 1.0f };
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	// written at the end, so the compiler can not drop the measured reads:
+	volatile float benchSink{ 0.0f };
+
+	struct Measurement {
+		double ns{ 0.0 };
+		size_t operations{ 0 };
+
+		template<typename Func>
+		void add(size_t operationCount, Func&& func)
+		{
+			const auto begin = Clock::now();
+			func();
+			ns += double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+			operations += operationCount;
+		}
+
+		double nsPerOperation() const { return operations ? ns / double(operations) : 0.0; }
+	};
+
+	struct StorageResult {
+		Measurement insert;
+		Measurement remove;
+		Measurement get;
+		Measurement iterate;
+		Measurement view;
+		size_t memory{ 0 };
+	};
+
+	/**
+	 * One round of all measurements on a new storage and a new EntityComponentManager.
+	 */
+	template<template<typename> class Storage>
+	void measureRound(StorageResult& result, size_t entityCount, float density, std::mt19937& rng)
+	{
+		std::vector<EntityHandleIndex> entities(entityCount);
+		std::iota(entities.begin(), entities.end(), EntityHandleIndex(0));
+		std::shuffle(entities.begin(), entities.end(), rng);
+		entities.resize(std::max(size_t(1), size_t(double(entityCount) * density)));
+
+		float sum{ 0.0f };
+		{
+			auto storage = std::make_unique<Storage<BenchComp>>();
+			result.insert.add(entities.size(), [&]() {
+				for (auto entity : entities) storage->insert(entity, BenchComp{});
+			});
+			result.memory = storage->memoryConsumtion();
+
+			std::shuffle(entities.begin(), entities.end(), rng);
+			result.get.add(entities.size(), [&]() {
+				for (auto entity : entities) sum += storage->get(entity).values[0];
+			});
+
+			result.iterate.add(storage->size(), [&]() {
+				for (auto iter = storage->begin(); iter != storage->end(); ++iter) sum += iter.data().values[1];
+			});
+
+			std::shuffle(entities.begin(), entities.end(), rng);
+			result.remove.add(entities.size(), [&]() {
+				for (auto entity : entities) storage->remove(entity);
+			});
+		}
+		{
+			using ECM = EntityComponentManager<Storage<BenchComp>, Storage<BenchCompOther>>;
+			auto world = std::make_unique<ECM>();
+			std::vector<EntityHandle> handles(entityCount);
+			for (auto& handle : handles) {
+				handle = world->create();
+				world->spawn(handle);
+			}
+			// every second entity with the first component also gets the second one:
+			size_t viewCount{ 0 };
+			for (size_t i = 0; i < entities.size(); ++i) {
+				world->template addComp<BenchComp>(handles[entities[i]]);
+				if (i % 2 == 0) {
+					world->template addComp<BenchCompOther>(handles[entities[i]]);
+					++viewCount;
+				}
+			}
+			result.view.add(viewCount, [&]() {
+				for (auto [entity, comp, other] : world->template entityComponentView<BenchComp, BenchCompOther>()) {
+					sum += comp.values[2] * other.values[0];
+				}
+			});
+		}
+		benchSink = benchSink + sum;
+	}
+
+	template<template<typename> class Storage>
+	void benchmarkStorage(std::ostream& out, char const* name, StorageBenchmarkConfig const& config, std::mt19937& rng)
+	{
+		for (size_t entityCount : config.entityCounts) {
+			for (float density : config.densities) {
+				const size_t componentCount = std::max(size_t(1), size_t(double(entityCount) * density));
+				const size_t rounds = std::max(size_t(1), config.minOperations / componentCount);
+
+				StorageResult result;
+				for (size_t round = 0; round < rounds; ++round) {
+					measureRound<Storage>(result, entityCount, density, rng);
+				}
+
+				out << std::left << std::setw(16) << name << std::right
+					<< std::setw(10) << entityCount
+					<< std::setw(8) << std::setprecision(3) << density * 100.0f << "%"
+					<< std::fixed << std::setprecision(2)
+					<< std::setw(10) << result.insert.nsPerOperation()
+					<< std::setw(10) << result.remove.nsPerOperation()
+					<< std::setw(10) << result.get.nsPerOperation()
+					<< std::setw(10) << result.iterate.nsPerOperation()
+					<< std::setw(10) << result.view.nsPerOperation()
+					<< std::setw(14) << result.memory
+					<< std::setw(10) << double(result.memory) / double(componentCount)
+					<< std::defaultfloat << std::endl;
+			}
+		}
+	}
+}
+
+void runStorageBenchmarks(std::ostream& out, StorageBenchmarkConfig const& config)
+{
+	std::mt19937 rng{ config.seed };
+
+	out << "component size: " << sizeof(BenchComp) << " bytes, times in ns per operation, memory in bytes\n";
+	out << std::left << std::setw(16) << "storage" << std::right
+		<< std::setw(10) << "entities"
+		<< std::setw(9) << "density"
+		<< std::setw(10) << "insert"
+		<< std::setw(10) << "remove"
+		<< std::setw(10) << "get"
+		<< std::setw(10) << "iterate"
+		<< std::setw(10) << "view"
+		<< std::setw(14) << "memory"
+		<< std::setw(10) << "mem/comp" << std::endl;
+
+	benchmarkStorage<ComponentStorageDirectIndexing>(out, "DirectIndexing", config, rng);
+	benchmarkStorage<ComponentStoragePagedIndexing>(out, "PagedIndexing", config, rng);
+	benchmarkStorage<ComponentStoragePagedSet>(out, "PagedSet", config, rng);
+}
+
+void runParallelEachBenchmarks(std::ostream& out, StorageBenchmarkConfig const& config)
+{
+	using ECM = EntityComponentManager<ComponentStorageOwningGroup<BenchComp, BenchCompOther>, ComponentStoragePagedSet<BenchCompExtra>>;
+
+	out << "parallelEach over an owning group, times in ns per visited entity\n";
+	out << std::left << std::setw(16) << "query" << std::right
+		<< std::setw(10) << "entities"
+		<< std::setw(10) << "time" << std::endl;
+
+	for (size_t entityCount : config.entityCounts) {
+		auto world = std::make_unique<ECM>();
+		const auto entities = world->createMany(entityCount);
+		world->addComps(entities, BenchComp{}, BenchCompOther{});
+		// every second entity of the group also gets the extra component:
+		std::vector<EntityHandle> extraEntities;
+		for (size_t i = 0; i < entities.size(); i += 2) {
+			extraEntities.push_back(entities[i]);
+		}
+		world->addComps(extraEntities, BenchCompExtra{});
+		for (auto entity : entities) {
+			world->spawn(entity);
+		}
+
+		const size_t rounds = std::max(size_t(1), config.minOperations / entityCount);
+		Measurement group;
+		Measurement groupAndExtra;
+		for (size_t round = 0; round < rounds; ++round) {
+			// the query has exactly the group's components, it iterates the packed group range:
+			group.add(entities.size(), [&]() {
+				parallelEach<BenchComp, BenchCompOther>(*world, [](EntityHandleIndex entity, BenchComp& comp, BenchCompOther& other) {
+					comp.values[0] += other.values[0];
+				});
+			});
+			// the extra component is not in the group, so the query falls back to the dense ranges of the smallest storage:
+			groupAndExtra.add(extraEntities.size(), [&]() {
+				parallelEach<BenchComp, BenchCompOther, BenchCompExtra>(*world, [](EntityHandleIndex entity, BenchComp& comp, BenchCompOther& other, BenchCompExtra& extra) {
+					comp.values[1] += other.values[1] * extra.value;
+				});
+			});
+		}
+		benchSink = benchSink + world->getComp<BenchComp>(entities.front()).values[0];
+
+		out << std::fixed << std::setprecision(2)
+			<< std::left << std::setw(16) << "group" << std::right
+			<< std::setw(10) << entityCount
+			<< std::setw(10) << group.nsPerOperation() << "\n"
+			<< std::left << std::setw(16) << "group+extra" << std::right
+			<< std::setw(10) << entityCount
+			<< std::setw(10) << groupAndExtra.nsPerOperation()
+			<< std::defaultfloat << std::endl;
+	}
+}
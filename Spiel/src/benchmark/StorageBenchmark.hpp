@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+struct StorageBenchmarkConfig {
+	std::vector<size_t> entityCounts{ 1'000, 10'000, 100'000, 1'000'000 };
+	std::vector<float> densities{ 0.01f, 0.1f, 0.5f, 1.0f };		// share of the entities that have the component
+	size_t minOperations{ 200'000 };							// small configurations are repeated until they did this many operations
+	uint32_t seed{ 1337 };
+};
+
+/**
+ * Measures ComponentStorageDirectIndexing, ComponentStoragePagedIndexing and ComponentStoragePagedSet without a window or the JobSystem.
+ *
+ * For every storage, entity count and density it measures in ns per operation:
+ * inserting and removing components of random entities, getting components of random entities,
+ * iterating all components of the storage and iterating an EntityComponentManager view over two components of the storage type.
+ * The memory is the storage's memoryConsumtion() when all components are inserted.
+ * Writes one line per configuration to out.
+ */
+void runStorageBenchmarks(std::ostream& out, StorageBenchmarkConfig const& config = StorageBenchmarkConfig{});
+
+/**
+ * Measures parallelEach on an EntityComponentManager with an owning group of two component types and a paged set for a third type.
+ * One query has exactly the group's component types, the other one also has the third type.
+ * Needs a running JobSystem. Writes one line per query and entity count to out.
+ */
+void runParallelEachBenchmarks(std::ostream& out, StorageBenchmarkConfig const& config = StorageBenchmarkConfig{});
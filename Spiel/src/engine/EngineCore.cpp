@@ -65,16 +65,20 @@ void EngineCore::run() {
 			break;
 		}
 
+		// all jobs of the frame are done, so the frame memory of all threads can be reused:
+		FrameArena::endFrame();
+
 	}
 
 	destroy();
 }
 
-void globalInitialize()
+void globalInitialize(JobSystem::Config const& jobSystemConfig, ThreadConfig const& renderThreadConfig)
 {
+	RenderPipelineThread::defaultConfig = renderThreadConfig;
 	if (!glfwInit()) {
 		std::cerr << "ERROR: failed to initialize GLEW!" << std::endl;
 		exit(-1);
 	}
-	JobSystem::initialize();
+	JobSystem::initialize(jobSystemConfig);
 }
@@ -13,10 +13,18 @@
 #include "types/BaseTypes.hpp"
 #include "rendering/Window.hpp"
 #include "rendering/Camera.hpp"
+#include "rendering/pipeline/RenderPipelineThread.hpp"
 #include "JobSystem.hpp"
+#include "allocator/FrameAllocator.hpp"
 #include "entity/EntityComponentManagerView.hpp"
 
-void globalInitialize();
+/**
+ * Initializes glfw and starts the JobSystem.
+ * 
+ * \param jobSystemConfig worker count, names and cpu affinity of the JobSystem workers.
+ * \param renderThreadConfig name and cpu affinity of the render threads of renderers created afterwards.
+ */
+void globalInitialize(JobSystem::Config const& jobSystemConfig = JobSystem::Config{}, ThreadConfig const& renderThreadConfig = RenderPipelineThread::defaultConfig);
 
 class EngineCore {
 public:
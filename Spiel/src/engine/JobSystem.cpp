@@ -1,107 +1,622 @@
 #include "JobSystem.hpp"
+#include "JobSystemTask.hpp"
+
+#include <typeinfo>
+#include <iomanip>
+#include <cstdlib>
 
 JobSystem::~JobSystem()
 {
 	reset();
 }
 
-void JobSystem::wait(Tag tag)
+void JobSystem::wait(Tag tag, WaitMode mode)
 {
-	std::unique_lock lock(mut);
 	assert(state == State::Running);
-	assert(batches.contains(tag));				// can not wait for non existant job
-	assert(!batches[tag].bOrphaned);			// can not wait for orphaned job
-	batches[tag].bWaitedFor = true;
+	JobBatch* batch = getJobBatch(tag);
+	assert(batch);								// can not wait for non existant or orphaned job
 
-	clientCV.wait(lock,
-		[&]() -> bool {
-			return batches[tag].jobsLeft == 0;
+	if (mode == WaitMode::Help && tlsQueueIndex >= 0) {
+		const uint32_t threadId = uint32_t(tlsQueueIndex);	// the queue index of a thread is also its thread id
+		uint32_t failedAttempts{ 0 };
+		while (batch->jobsLeft > 0 && failedAttempts < SPINS_BEFORE_SLEEP) {
+			if (JobRecord* record = findJob(tlsQueueIndex, false)) {
+				failedAttempts = 0;
+				executeJob(record, threadId);
+			}
+			else {
+				++failedAttempts;
+				std::this_thread::yield();
+			}
 		}
-	);
-	deleteJobBatch(tag);
+	}
+
+	batch->bWaitedFor = true;
+	{
+		std::unique_lock lock(waitMut);
+		clientCV.wait(lock,
+			[&]() -> bool {
+				return batch->jobsLeft == 0;
+			}
+		);
+	}
+	releaseJobBatch(batch);
 }
 
 void JobSystem::initialize()
 {
-	std::unique_lock lock(mut);
+	initialize(Config{});
+}
+
+void JobSystem::initialize(Config const& config)
+{
 	assert(state == State::Uninitialized);
+
+	threadCount = config.workerCount > 0 ? config.workerCount : defaultWorkerCount();
+
+	arenaBlocks.clear();
+	for (auto& queueList : queues) {
+		queueList.clear();
+	}
+	for (size_t i = 0; i < threadCount + 1; ++i) {
+		for (auto& queueList : queues) {
+			queueList.push_back(std::make_unique<WorkStealingQueue<JobRecord*>>());
+		}
+		arenaBlocks.push_back(new JobArenaBlock());
+	}
+	backgroundWorkerLimit = std::max<size_t>(threadCount / 4, 1);
+	tlsQueueIndex = threadCount;	// the initializing thread is the client thread
+
 	state = State::Running;
 
+	setCurrentThreadAffinity(config.clientAffinityMask);
+
+	threadNames.clear();
+	for (uint32_t id = 0; id < threadCount; ++id) {
+		threadNames.push_back(config.workerName + " " + std::to_string(id));
+	}
+	threadNames.push_back("Client");
+
 	threads.reserve(threadCount);
 	for (uint32_t id = 0; id < threadCount; ++id) {
 		threads.push_back(std::thread(workerFunction, id));
-		threads.back().detach();
+		ThreadConfig threadConfig{ threadNames[id] };
+		if (!config.workerAffinityMasks.empty()) {
+			threadConfig.affinityMask = config.workerAffinityMasks[id % config.workerAffinityMasks.size()];
+		}
+		applyThreadConfig(threads.back(), threadConfig);
+	}
+
+	// the workers must be joined before the static members they use are destroyed:
+	static bool bExitHandlerRegistered{ false };
+	if (!bExitHandlerRegistered) {
+		bExitHandlerRegistered = true;
+		std::atexit([]() {
+			if (state == State::Running) {
+				reset();
+			}
+		});
 	}
 }
 
 void JobSystem::reset()
 {
-	std::unique_lock lock(mut);
-	assert(state == State::Uninitialized);
-	state = State::Uninitialized;
+	if (tracing()) {
+		endTrace();
+	}
+	{
+		std::unique_lock lock(sleepMut);
+		assert(state == State::Running);
+		state = State::Uninitialized;
+	}
 	workerCV.notify_all();
 
-	for (auto& thread : threads) thread.join();
-
+	// the queues and arena blocks are only freed when no worker can access them anymore:
+	for (auto& thread : threads) {
+		thread.join();
+	}
 	threads.clear();
+
+	// blocks still used by unfinished jobs are freed when these jobs are released:
+	for (JobArenaBlock* block : arenaBlocks) {
+		freeJobMemory(nullptr, block);
+	}
+	arenaBlocks.clear();
 }
 
 void JobSystem::orphan(Tag tag)
 {
-	std::unique_lock lock(mut);
 	assert(state == State::Running);
-	if (batches.contains(tag)) {
-		batches[tag].bOrphaned = true;
+	if (JobBatch* batch = getJobBatch(tag)) {
+		releaseJobBatch(batch);
 	}
 }
 
 bool JobSystem::finished(Tag tag)
 {
-	std::unique_lock lock(mut);
 	assert(state == State::Running);
-	assert(batches.contains(tag));
+	JobBatch* batch = getJobBatch(tag);
+	assert(batch);
 
-	if (batches[tag].jobsLeft == 0) {
-		deleteJobBatch(tag);
+	if (batch->jobsLeft == 0) {
+		releaseJobBatch(batch);
 		return true;
 	}
 	return false;
 }
 
-void JobSystem::deleteJobBatch(Tag tag)
+std::pair<JobSystem::Tag, JobSystem::JobBatch*> JobSystem::allocateJobBatch(void* memory, void(*destructor)(void*), JobArenaBlock* arenaBlock, size_t jobCount, Priority priority)
 {
-	batches[tag].destructor(batches[tag].memory);
-	delete batches[tag].memory;
-	batches.erase(tag);
+	uint32_t index{ 0 };
+	{
+		std::unique_lock lock(batchPoolMut);
+		if (freeBatchIndices.empty()) {
+			index = nextBatchIndex++;
+			assert((index >> BATCH_PAGE_BITS) < BATCH_PAGE_COUNT);	// too many job batches alive at the same time
+			if (!batchPages[index >> BATCH_PAGE_BITS]) {
+				batchPages[index >> BATCH_PAGE_BITS] = std::make_unique<JobBatchPage>();
+			}
+		}
+		else {
+			index = freeBatchIndices.back();
+			freeBatchIndices.pop_back();
+		}
+	}
+
+	JobBatch* batch = &batchPages[index >> BATCH_PAGE_BITS]->batches[index & BATCH_OFFSET_MASK];
+	batch->poolIndex = index;
+	batch->memory = memory;
+	batch->destructor = destructor;
+	batch->arenaBlock = arenaBlock;
+	batch->records.clear();
+	batch->records.reserve(jobCount);
+	batch->continuationNodes.clear();
+	batch->continuations = nullptr;
+	batch->bWaitedFor = false;
+	batch->priority = priority;
+	batch->unfinishedPrerequisites = 1;	// released at the end of scheduleJobBatch
+	batch->jobsLeft = jobCount + 1;		// + 1 for the pseudo job that waits for the prerequisites
+	batch->refCount = jobCount + 2;		// + 1 for the client, + 1 for the pseudo job
+
+	const Tag tag = (Tag(batch->generation.load()) << 32) | Tag(index);
+	return { tag, batch };
 }
 
-void JobSystem::workerFunction(const uint32_t id)
+JobSystem::Tag JobSystem::submitTask(Task<void>&& task, Priority priority)
 {
-	std::unique_lock lock(mut);
-	for (;;) {
-		workerCV.wait(lock,
-			[&]() {
-				return !jobQueue.empty() || state == State::Uninitialized /* State::Unititialized is also used to notify all running workers to stop */;
+	assert(state == State::Running);
+	assert(task.handle);
+
+	class TaskJob : public IJob {
+	public:
+		TaskJob(Task<void>&& task) : task{ std::move(task) } {}
+		virtual void execute(const uint32_t threadId) override
+		{
+			task.handle.resume();
+		}
+		Task<void> task;
+	};
+
+	auto [jobMemory, arenaBlock] = allocateJobMemory(sizeof(TaskJob), alignof(TaskJob), true);
+	TaskJob* job = new (jobMemory) TaskJob(std::move(task));
+	// one job starts the coroutine, the second one is finished when the coroutine completes:
+	auto [tag, batch] = allocateJobBatch((void*)job, &deletor<TaskJob>, arenaBlock, 2, priority);
+	auto& promise = job->task.handle.promise();
+	promise.onComplete = [](void* batch) { finishJob(reinterpret_cast<JobBatch*>(batch)); };
+	promise.onCompleteContext = batch;
+	batch->records.push_back({ static_cast<IJob*>(job), batch });
+	scheduleJobBatch(batch, {});
+
+	return tag;
+}
+
+JobSystem::ScheduleAwaiter JobSystem::schedule(Priority priority)
+{
+	return ScheduleAwaiter{ priority };
+}
+
+JobSystem::TagAwaiter JobSystem::after(Tag tag, Priority priority)
+{
+	return TagAwaiter{ tag, priority };
+}
+
+JobSystem::Tag JobSystem::submitShared(IJob* job, size_t executionCount)
+{
+	assert(state == State::Running);
+
+	auto [tag, batch] = allocateJobBatch(nullptr, nullptr, nullptr, executionCount, Priority::FrameCritical);
+	for (size_t i = 0; i < executionCount; ++i) {
+		batch->records.push_back({ job, batch });
+	}
+	scheduleJobBatch(batch, {});
+
+	return tag;
+}
+
+void JobSystem::scheduleJobBatch(JobBatch* batch, std::span<const Tag> prerequisites)
+{
+	// the nodes must not move after they are linked, so they are all created up front:
+	batch->continuationNodes.resize(prerequisites.size());
+	batch->unfinishedPrerequisites += uint32_t(prerequisites.size());
+
+	for (size_t i = 0; i < prerequisites.size(); ++i) {
+		JobBatch* prerequisite = getJobBatch(prerequisites[i]);
+		assert(prerequisite);	// prerequisites must be valid tags that are not consumed yet
+
+		Continuation* node = &batch->continuationNodes[i];
+		node->dependent = batch;
+		Continuation* head = prerequisite->continuations.load();
+		bool bLinked{ false };
+		while (head != &closedContinuations) {
+			node->next = head;
+			if (prerequisite->continuations.compare_exchange_weak(head, node)) {
+				bLinked = true;
+				break;
+			}
+		}
+		if (!bLinked) /* the prerequisite is already finished */ {
+			batch->unfinishedPrerequisites -= 1;
+		}
+	}
+
+	prerequisiteFinished(batch);
+}
+
+void JobSystem::prerequisiteFinished(JobBatch* batch)
+{
+	if (batch->unfinishedPrerequisites.fetch_sub(1) == 1) {
+		pushJobBatch(batch);
+		finishJob(batch);	// the pseudo job
+	}
+}
+
+std::pair<void*, JobSystem::JobArenaBlock*> JobSystem::allocateJobMemory(size_t size, size_t alignment, bool bLongLived)
+{
+	if (tlsQueueIndex < 0 || size > MAX_JOB_ARENA_ALLOCATION || bLongLived) {
+		assert(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+		return { ::operator new(size), nullptr };
+	}
+	assert(alignment <= 64);
+
+	JobArenaBlock*& block = arenaBlocks[tlsQueueIndex];
+	if (block->refCount == 1) /* all allocations of the block are released */ {
+		block->used = 0;
+	}
+
+	size_t offset = (block->used + alignment - 1) & ~(alignment - 1);
+	if (offset + size > JOB_ARENA_BLOCK_SIZE) {
+		// the block is full and still in use, the last allocation to be released frees it:
+		if (block->refCount.fetch_sub(1) == 1) {
+			delete block;
+		}
+		block = new JobArenaBlock();
+		offset = 0;
+	}
+
+	block->used = offset + size;
+	block->refCount += 1;
+	return { block->memory + offset, block };
+}
+
+void JobSystem::freeJobMemory(void* memory, JobArenaBlock* arenaBlock)
+{
+	if (arenaBlock) {
+		if (arenaBlock->refCount.fetch_sub(1) == 1) {
+			delete arenaBlock;
+		}
+	}
+	else {
+		::operator delete(memory);
+	}
+}
+
+void JobSystem::pushJobBatch(JobBatch* batch)
+{
+	const size_t jobCount = batch->records.size();
+	if (jobCount == 0) return;
+
+	if (batch->priority == Priority::Background) {
+		{
+			std::unique_lock lock(backgroundMut);
+			for (auto& record : batch->records) {
+				backgroundQueue.push_back(&record);
+			}
+		}
+		backgroundQueueSize += jobCount;
+		notifyWorkers(std::min(jobCount, backgroundWorkerLimit));
+		return;
+	}
+
+	const size_t priority = size_t(batch->priority);
+	if (tlsQueueIndex >= 0) {
+		auto& queue = *queues[priority][tlsQueueIndex];
+		for (auto& record : batch->records) {
+			queue.push(&record);
+		}
+	}
+	else {
+		std::unique_lock lock(injectionMut);
+		for (auto& record : batch->records) {
+			injectionQueues[priority].push_back(&record);
+		}
+		injectionQueueSizes[priority] += jobCount;
+	}
+
+	queuedJobs += jobCount;
+	notifyWorkers(jobCount);
+}
+
+void JobSystem::notifyWorkers(size_t jobCount)
+{
+	if (sleepingWorkers > 0) {
+		// taking the lock makes sure that no worker is between checking its predicate and going to sleep:
+		std::unique_lock lock(sleepMut);
+	}
+	if (jobCount == 1) {
+		workerCV.notify_one();
+	}
+	else {
+		workerCV.notify_all();
+	}
+}
+
+JobSystem::JobBatch* JobSystem::getJobBatch(Tag tag)
+{
+	const uint32_t index = uint32_t(tag & 0xFFFFFFFF);
+	const uint32_t generation = uint32_t(tag >> 32);
+	if ((index >> BATCH_PAGE_BITS) >= BATCH_PAGE_COUNT || !batchPages[index >> BATCH_PAGE_BITS]) {
+		return nullptr;
+	}
+	JobBatch* batch = &batchPages[index >> BATCH_PAGE_BITS]->batches[index & BATCH_OFFSET_MASK];
+	if (batch->generation != generation || batch->refCount == 0) {
+		return nullptr;
+	}
+	return batch;
+}
+
+void JobSystem::releaseJobBatch(JobBatch* batch)
+{
+	if (batch->refCount.fetch_sub(1) == 1) {
+		if (batch->memory) {
+			batch->destructor(batch->memory);
+			freeJobMemory(batch->memory, batch->arenaBlock);
+			batch->memory = nullptr;
+		}
+		batch->generation += 1;		// invalidates all tags for this batch
+
+		std::unique_lock lock(batchPoolMut);
+		freeBatchIndices.push_back(batch->poolIndex);
+	}
+}
+
+void JobSystem::executeJob(JobRecord* record, const uint32_t threadId)
+{
+	JobBatch* batch = record->batch;
+	const Priority priority = batch->priority;
+	const uint64_t session = traceSession.load(std::memory_order_acquire);
+	if (session & 1) {
+		executeTracedJob(record, threadId, session);
+	}
+	else {
+		record->job->execute(threadId);
+	}
+	finishJob(batch);
+
+	if (priority == Priority::Background) {
+		runningBackgroundJobs -= 1;
+		if (backgroundQueueSize > 0) /* a worker may have gone to sleep because the limit was reached */ {
+			notifyWorkers(1);
+		}
+	}
+}
+
+void JobSystem::executeTracedJob(JobRecord* record, const uint32_t threadId, uint64_t session)
+{
+	JobBatch* batch = record->batch;
+	JobTraceEvent event;
+	event.label = record->job->traceLabel();
+	if (!event.label) {
+		event.label = typeid(*record->job).name();
+	}
+	event.tag = (Tag(batch->generation.load()) << 32) | Tag(batch->poolIndex);
+	event.begin = traceTime();
+	record->job->execute(threadId);
+	event.end = traceTime();
+
+	// the trace may have ended while the job was running, then the buffer must not be touched anymore:
+	pushingTraceThreads += 1;
+	if (traceSession.load() == session) {
+		traceBuffers[threadId]->push(event);
+	}
+	pushingTraceThreads -= 1;
+}
+
+void JobSystem::beginTrace(size_t eventsPerThread)
+{
+	assert(state == State::Running);
+	assert(!tracing());
+
+	const size_t capacity = std::bit_ceil(std::max<size_t>(eventsPerThread, 1));
+	if (traceBuffers.size() != jobThreadCount() || traceBuffers.front()->capacity() != capacity) {
+		traceBuffers.clear();
+		for (size_t i = 0; i < jobThreadCount(); ++i) {
+			traceBuffers.push_back(std::make_unique<JobTraceBuffer>(capacity));
+		}
+	}
+	for (auto& buffer : traceBuffers) {
+		buffer->clear();
+	}
+	traceStart.store(steadyTimeNs(), std::memory_order_relaxed);
+	traceSession.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::endTrace()
+{
+	assert(tracing());
+	traceSession.fetch_add(1);
+	while (pushingTraceThreads > 0) {
+		std::this_thread::yield();
+	}
+}
+
+static void writeJsonString(std::ostream& out, char const* str)
+{
+	out << '"';
+	for (; *str; ++str) {
+		if (*str == '"' || *str == '\\') {
+			out << '\\';
+		}
+		out << *str;
+	}
+	out << '"';
+}
+
+void JobSystem::writeTrace(std::ostream& out)
+{
+	assert(!tracing());
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool bFirst{ true };
+	auto separate = [&]() {
+		if (!bFirst) out << ",";
+		out << "\n";
+		bFirst = false;
+	};
+
+	for (size_t threadId = 0; threadId < traceBuffers.size(); ++threadId) {
+		separate();
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadId << ",\"args\":{\"name\":";
+		writeJsonString(out, threadId < threadNames.size() ? threadNames[threadId].c_str() : "Thread");
+		out << "}}";
+	}
+
+	const auto oldFlags = out.flags();
+	const auto oldPrecision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	for (size_t threadId = 0; threadId < traceBuffers.size(); ++threadId) {
+		traceBuffers[threadId]->forEach(
+			[&](JobTraceEvent const& event) {
+				separate();
+				out << "{\"name\":";
+				writeJsonString(out, event.label);
+				out << ",\"cat\":\"job\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadId
+					<< ",\"ts\":" << double(event.begin) * 0.001
+					<< ",\"dur\":" << double(event.end - event.begin) * 0.001
+					<< ",\"args\":{\"tag\":" << event.tag << "}}";
 			}
 		);
-		if (state == State::Uninitialized) return;
+	}
+	out.flags(oldFlags);
+	out.precision(oldPrecision);
+	out << "\n]}\n";
+}
 
-		auto [tag, job] = jobQueue.back();
-		jobQueue.pop_back();
+void JobSystem::finishJob(JobBatch* batch)
+{
+	if (batch->jobsLeft.fetch_sub(1) == 1) /* if there are no jobs left in a batch the job batch is completed */ {
+		Continuation* node = batch->continuations.exchange(&closedContinuations);
+		while (node) {
+			// the node lives in the dependent batch, which can be released as soon as it is notified:
+			Continuation* next = node->next;
+			prerequisiteFinished(node->dependent);
+			node = next;
+		}
 
-		lock.unlock();
-		job->execute(id);
-		lock.lock();
+		if (batch->bWaitedFor) {
+			std::unique_lock lock(waitMut);
+			clientCV.notify_all();
+		}
+	}
+	releaseJobBatch(batch);
+}
 
-		auto& batch = batches[tag];
-		batch.jobsLeft -= 1;
-		if (batch.jobsLeft == 0) /* if there are no jobs left in a batch the job batch is completed */ {
-			if (batch.bOrphaned) {
-				deleteJobBatch(tag);
+JobSystem::JobRecord* JobSystem::findJob(int64_t queueIndex, bool bAllowBackground)
+{
+	const int64_t queueCount = int64_t(queues[0].size());
+	for (size_t priority = 0; priority < QUEUED_PRIORITY_COUNT; ++priority) {
+		JobRecord* record{ nullptr };
+		if (queueIndex >= 0) {
+			record = queues[priority][queueIndex]->pop();
+		}
+		if (!record && injectionQueueSizes[priority] > 0) {
+			std::unique_lock lock(injectionMut);
+			if (!injectionQueues[priority].empty()) {
+				record = injectionQueues[priority].front();
+				injectionQueues[priority].pop_front();
+				injectionQueueSizes[priority] -= 1;
 			}
-			else if (batch.bWaitedFor) {
-				clientCV.notify_one();
+		}
+		// steal from the other threads, beginning with the next one to spread the thieves:
+		for (int64_t i = 1; !record && i <= queueCount; ++i) {
+			const int64_t victim = (queueIndex + i) % queueCount;
+			if (victim != queueIndex) {
+				record = queues[priority][victim]->steal();
 			}
 		}
+		if (record) {
+			queuedJobs -= 1;
+			return record;
+		}
+	}
+	return bAllowBackground ? takeBackgroundJob() : nullptr;
+}
+
+JobSystem::JobRecord* JobSystem::takeBackgroundJob()
+{
+	if (backgroundQueueSize == 0) return nullptr;
+
+	// reserve a background slot first, so the limit is never exceeded:
+	size_t running = runningBackgroundJobs.load();
+	do {
+		if (running >= backgroundWorkerLimit) return nullptr;
+	} while (!runningBackgroundJobs.compare_exchange_weak(running, running + 1));
+
+	JobRecord* record{ nullptr };
+	{
+		std::unique_lock lock(backgroundMut);
+		if (!backgroundQueue.empty()) {
+			record = backgroundQueue.front();
+			backgroundQueue.pop_front();
+			backgroundQueueSize -= 1;
+		}
+	}
+	if (!record) {
+		runningBackgroundJobs -= 1;
+	}
+	return record;
+}
+
+bool JobSystem::backgroundJobAvailable()
+{
+	return backgroundQueueSize > 0 && runningBackgroundJobs < backgroundWorkerLimit;
+}
+
+void JobSystem::workerFunction(const uint32_t id)
+{
+	tlsQueueIndex = id;
+	uint32_t failedAttempts{ 0 };
+	for (;;) {
+		if (state == State::Uninitialized) return;
+
+		if (JobRecord* record = findJob(id, true)) {
+			failedAttempts = 0;
+			executeJob(record, id);
+			continue;
+		}
+
+		if (++failedAttempts < SPINS_BEFORE_SLEEP) {
+			std::this_thread::yield();
+			continue;
+		}
+		failedAttempts = 0;
+
+		std::unique_lock lock(sleepMut);
+		sleepingWorkers += 1;
+		workerCV.wait(lock,
+			[&]() {
+				return queuedJobs > 0 || backgroundJobAvailable() || state == State::Uninitialized /* State::Unititialized is also used to notify all running workers to stop */;
+			}
+		);
+		sleepingWorkers -= 1;
+		if (state == State::Uninitialized) return;
 	}
 }
@@ -3,12 +3,26 @@
 #include <thread>
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
 #include <cinttypes>
 #include <deque>
 #include <vector>
-#include <unordered_map>
+#include <array>
+#include <memory>
 #include <cassert>
 #include <functional>
+#include <algorithm>
+#include <span>
+#include <initializer_list>
+#include <string>
+#include <ostream>
+#include <chrono>
+#include <new>
+
+#include "types/WorkStealingQueue.hpp"
+#include "types/SmallFunction.hpp"
+#include "util/Thread.hpp"
+#include "util/JobTrace.hpp"
 
 // TODO maybe move it into some sort of reflection hpp
 template<typename T>
@@ -23,17 +37,32 @@ void deletor(void* el)
 class IJob {
 public:
 	virtual void execute(const uint32_t threadId) = 0;
+
+	/**
+	 * \return name of the job in job traces, nullptr uses the name of the job's type.
+	 */
+	virtual char const* traceLabel() const { return nullptr; }
 };
 
+/**
+ * Job that calls a lambda.
+ * Lambdas with small captures are stored inside the job, so creating a LambdaJob usually does not allocate.
+ */
 class LambdaJob : public IJob {
 public:
-	LambdaJob(std::function<void(uint32_t)>&& lambda) : lambda{ lambda }{}
+	/**
+	 * \param label name of the job in job traces, must outlive the trace.
+	 */
+	template<typename Func> requires (!std::is_same_v<std::decay_t<Func>, LambdaJob>)
+	LambdaJob(Func&& lambda, char const* label = "LambdaJob") : lambda{ std::forward<Func>(lambda) }, label{ label }{}
 	virtual void execute(const uint32_t threadId) override
 	{
 		lambda(threadId);
 	}
+	virtual char const* traceLabel() const override { return label; }
 private:
-	std::function<void(uint32_t)> lambda;
+	SmallFunction<void(uint32_t)> lambda;
+	char const* label;
 };
 
 template<typename T>
@@ -42,10 +71,38 @@ template<typename T>
  */
 concept CJob = std::is_base_of_v<IJob, T>;
 
+/**
+ * Work stealing job system.
+ * Every worker thread owns a lock free deque (see WorkStealingQueue). 
+ * The thread that initializes the JobSystem (the client thread) owns a deque as well.
+ * Jobs submitted from a worker or the client thread are pushed into the submitting threads own deque, 
+ * idle workers steal from the deques of other threads.
+ * Jobs submitted from any other thread are pushed into a mutex guarded injection queue.
+ * Completion of jobs is tracked with atomic counters in the job batches, so executing and finishing jobs never takes a lock.
+ * 
+ * The memory for submitted jobs is taken from a job arena of the submitting thread (see JobArenaBlock), so submitting usually does not allocate.
+ * 
+ * Job batches can be submitted with prerequisites (tags of other job batches).
+ * Such a batch is only queued when all its prerequisites are finished, it is queued by the thread that finishes the last one.
+ * This way chains of dependent work do not need a thread that waits between the steps.
+ * 
+ * Every batch has a Priority. FrameCritical and Normal jobs have their own deques, threads always look for FrameCritical jobs first.
+ * Background jobs are kept in a separate lane, they are only executed by workers that found no other job,
+ * and never by more than maxBackgroundWorkers() workers at the same time.
+ */
 class JobSystem {
 public:
 	using Tag = uint64_t;
 
+	/**
+	 * Priority class of a job batch.
+	 */
+	enum class Priority : uint32_t {
+		FrameCritical,	// the current frame waits for it
+		Normal,
+		Background		// long running work like io or serialization, executed by a limited number of workers
+	};
+
 	~JobSystem();
 
 	/**
@@ -55,69 +112,209 @@ public:
 	 * After submitting a job, it is illigal to use the jobs memory.
 	 * The Tag one gets from this function can be used to get information about job after submission, for example wait(Tag) or finished(Tag).
 	 * 
+	 * The job is not executed before all prerequisites are finished.
+	 * The prerequisite tags stay valid and must still be consumed with wait, finished or orphan.
+	 * A tag must only be used as a prerequisite BEFORE it is consumed.
+	 * 
 	 * \param job is a class that derives from the Base Class IJob, and implements the function void execute(uint32_t thread).
+	 * \param prerequisites tags of job batches that must be finished before the job is executed.
+	 * \param priority of the job.
 	 * \return tag that is used to identify the job. 
 	 */
 	template<CJob TJob>
-	static Tag submit(TJob&& job)
+	static Tag submit(TJob&& job, std::span<const Tag> prerequisites = {}, Priority priority = Priority::Normal)
 	{
-		std::unique_lock lock(mut);
 		assert(state == State::Running);
-		Tag tag = nextJobTag++;
-		
-		TJob* jobMemPtr = new TJob(std::move(job));
-		auto newbatch = JobBatch((void*)jobMemPtr, 1ull );
-		newbatch.destructor = deletor<TJob>;
-		batches[tag] = newbatch;
-		jobQueue.push_back({ tag, static_cast<IJob*>(jobMemPtr) });
-	
-		workerCV.notify_one();
-	
+
+		auto [jobMemory, arenaBlock] = allocateJobMemory(sizeof(TJob), alignof(TJob), priority == Priority::Background);
+		TJob* jobMemPtr = new (jobMemory) TJob(std::move(job));
+		auto [tag, batch] = allocateJobBatch((void*)jobMemPtr, &deletor<TJob>, arenaBlock, 1, priority);
+		batch->records.push_back({ static_cast<IJob*>(jobMemPtr), batch });
+		scheduleJobBatch(batch, prerequisites);
+
 		return tag;
 	}
 
+	template<CJob TJob>
+	static Tag submit(TJob&& job, std::initializer_list<Tag> prerequisites, Priority priority = Priority::Normal)
+	{
+		return submit(std::move(job), std::span<const Tag>(prerequisites.begin(), prerequisites.size()), priority);
+	}
+
+	template<CJob TJob>
+	static Tag submit(TJob&& job, Priority priority)
+	{
+		return submit(std::move(job), std::span<const Tag>{}, priority);
+	}
+
 	/**
 	 * Submits a list of jobs to be executed in parallel by worker threads.
 	 * The job list that is submitted must be an RVALUE.
 	 * The Jobsystem takes the ownership of the memory of the job list.
 	 * After submitting a job list, it is illigal to use the jobs memory.
 	 * The Tag one gets from this function can be used to get information about the job list after submission, for example wait(Tag) or finished(Tag).
+	 * 
+	 * No job of the list is executed before all prerequisites are finished, see submit.
 	 *
 	 * \param jobList is a vector that contains objects of a class that derives from the Base Class IJob, and implements the function void execute(uint32_t thread).
+	 * \param prerequisites tags of job batches that must be finished before the jobs are executed.
+	 * \param priority of the jobs.
 	 * \return tag that is used to identify the job.
 	 */
 	template<CJob TJob, typename TAllocator>
-	static Tag submitVec(std::vector<TJob, TAllocator>&& jobList)
+	static Tag submitVec(std::vector<TJob, TAllocator>&& jobList, std::span<const Tag> prerequisites = {}, Priority priority = Priority::Normal)
 	{
-		std::unique_lock lock(mut);
 		assert(state == State::Running);
-		Tag tag = nextJobTag++;
 
 		const size_t jobListSize = jobList.size();
-		std::vector<TJob, TAllocator>* jobMemPtr = new std::vector<TJob, TAllocator>(std::move(jobList));
-		JobBatch newbatch = { (void*)jobMemPtr, jobListSize };
-		newbatch.destructor = deletor<std::vector<TJob, TAllocator>>;
-		batches[tag] = newbatch;
-
+		// only the vector object is moved into the arena, the jobs stay in the memory of the vector:
+		using JobList = std::vector<TJob, TAllocator>;
+		auto [jobMemory, arenaBlock] = allocateJobMemory(sizeof(JobList), alignof(JobList), priority == Priority::Background);
+		JobList* jobMemPtr = new (jobMemory) JobList(std::move(jobList));
+		auto [tag, batch] = allocateJobBatch((void*)jobMemPtr, &deletor<JobList>, arenaBlock, jobListSize, priority);
 		for (auto& job : *jobMemPtr) {
-			jobQueue.push_back({ tag, static_cast<IJob*>(&job) });
+			batch->records.push_back({ static_cast<IJob*>(&job), batch });
 		}
-
-		workerCV.notify_all();
+		scheduleJobBatch(batch, prerequisites);
 
 		return tag;
 	}
 
+	template<CJob TJob, typename TAllocator>
+	static Tag submitVec(std::vector<TJob, TAllocator>&& jobList, std::initializer_list<Tag> prerequisites, Priority priority = Priority::Normal)
+	{
+		return submitVec(std::move(jobList), std::span<const Tag>(prerequisites.begin(), prerequisites.size()), priority);
+	}
+
+	template<CJob TJob, typename TAllocator>
+	static Tag submitVec(std::vector<TJob, TAllocator>&& jobList, Priority priority)
+	{
+		return submitVec(std::move(jobList), std::span<const Tag>{}, priority);
+	}
+
+	/**
+	 * Calls func(chunkBegin, chunkEnd, threadId) for chunks that together cover the range [begin, end).
+	 * The chunks are executed in parallel by the workers and the calling thread, the function returns when the whole range is processed.
+	 * 
+	 * The range is split lazily: every participating thread repeatedly takes the next chunk from a shared cursor.
+	 * A chunk is half of the remaining range divided by the thread count, but at least grainSize indices.
+	 * So the chunks are big at the beginning and get smaller to the end, which balances the load without tuning per call site.
+	 * The job lives on the stack of the calling thread, so no memory is allocated.
+	 * As the calling thread waits for the jobs, they are submitted with Priority::FrameCritical.
+	 * 
+	 * \param begin first index of the range.
+	 * \param end one past the last index of the range.
+	 * \param func callable with the signature void(size_t chunkBegin, size_t chunkEnd, uint32_t threadId).
+	 * \param grainSize minimal count of indices in a chunk, 0 selects it with autoGrainSize.
+	 * \param label name of the jobs in job traces.
+	 */
+	template<typename RangeFunc>
+	static void parallelForRange(size_t begin, size_t end, RangeFunc&& func, size_t grainSize = 0, char const* label = "parallelFor")
+	{
+		assert(state == State::Running);
+		if (begin >= end) return;
+
+		const size_t count = end - begin;
+		if (grainSize == 0) {
+			grainSize = autoGrainSize(count);
+		}
+
+		if (count <= grainSize && tlsQueueIndex >= 0) {
+			// too small to be split, a thread with an id can just do it itself:
+			func(begin, end, uint32_t(tlsQueueIndex));
+			return;
+		}
+
+		ParallelForJob<std::remove_reference_t<RangeFunc>> job{ begin, end, grainSize, func, label };
+		const size_t chunkCount = (count + grainSize - 1) / grainSize;
+		wait(submitShared(&job, std::min(chunkCount, jobThreadCount())));
+	}
+
+	/**
+	 * Calls func(index, threadId) for every index in the range [begin, end) in parallel.
+	 * The range is split like in parallelForRange.
+	 * 
+	 * \param func callable with the signature void(size_t index, uint32_t threadId).
+	 * \param grainSize minimal count of indices in a chunk, 0 selects it with autoGrainSize.
+	 * \param label name of the jobs in job traces.
+	 */
+	template<typename IndexFunc>
+	static void parallelFor(size_t begin, size_t end, IndexFunc&& func, size_t grainSize = 0, char const* label = "parallelFor")
+	{
+		parallelForRange(begin, end,
+			[&](size_t chunkBegin, size_t chunkEnd, uint32_t threadId) {
+				for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+					func(i, threadId);
+				}
+			},
+			grainSize,
+			label
+		);
+	}
+
+	/**
+	 * Maps every index in the range [begin, end) to a value and reduces all values to one in parallel.
+	 * Each chunk is reduced on its own, the chunk results are then reduced into the result under a lock.
+	 * The order in which the chunk results are combined is not defined, so reduce must be associative and commutative.
+	 * 
+	 * \param identity value that does not change the result when reduced with it, for example 0 for a sum.
+	 * \param map callable with the signature T(size_t index).
+	 * \param reduce callable with the signature T(T a, T b).
+	 * \param grainSize minimal count of indices in a chunk, 0 selects it with autoGrainSize.
+	 * \return the reduced value, identity for an empty range.
+	 */
+	template<typename T, typename MapFunc, typename ReduceFunc>
+	static T parallelReduce(size_t begin, size_t end, T identity, MapFunc&& map, ReduceFunc&& reduce, size_t grainSize = 0)
+	{
+		T result = identity;
+		std::mutex resultMut;
+		parallelForRange(begin, end,
+			[&](size_t chunkBegin, size_t chunkEnd, uint32_t threadId) {
+				T chunkResult = identity;
+				for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+					chunkResult = reduce(std::move(chunkResult), map(i));
+				}
+				std::unique_lock lock(resultMut);
+				result = reduce(std::move(result), std::move(chunkResult));
+			},
+			grainSize
+		);
+		return result;
+	}
+
+	/**
+	 * \return a grain size for count elements that gives every thread that can execute jobs enough chunks for load balancing.
+	 */
+	static size_t autoGrainSize(size_t count)
+	{
+		return std::max<size_t>(1, count / (jobThreadCount() * AUTO_GRAIN_CHUNKS_PER_THREAD));
+	}
+
+	/**
+	 * Selects what a thread does while it waits for a job batch in wait(Tag, WaitMode).
+	 */
+	enum class WaitMode {
+		Help,	// the waiting thread executes queued jobs until the batch is finished
+		Sleep	// the waiting thread sleeps until the batch is finished
+	};
+
 	/**
 	 * Stops the curret thread until job batch belonging to the given tag is finished.
 	 * Deletes memory for job batch at the end of the function.
 	 * Deletes Tag from System after call.
 	 * 
+	 * In WaitMode::Help the waiting thread executes jobs while it waits, beginning with the most recently pushed jobs of its own queue,
+	 * these are usually the jobs of the batch it waits for. When no job is left to take, it sleeps until the batch is finished.
+	 * A helping thread can also pick up unrelated jobs, so a long running job can delay the return of wait.
+	 * Background jobs are never picked up by a helping thread.
+	 * Only the client thread and the workers can help, all other threads always sleep.
+	 * 
 	 * Call with invalid tag will cause an assertion failure.
 	 * 
 	 * \param tag used to identify the job batch.
+	 * \param mode selects if the thread helps executing jobs while waiting.
 	 */
-	static void wait(Tag tag);
+	static void wait(Tag tag, WaitMode mode = WaitMode::Help);
 
 	/**
 	 * Checks if job is finished.
@@ -142,36 +339,185 @@ public:
 	 */
 	static void orphan(Tag tag);
 
+	/**
+	 * Settings for the worker threads of the JobSystem.
+	 */
+	struct Config {
+		size_t workerCount{ 0 };					// 0 creates one worker per hardware thread, minus one for the client thread
+		std::vector<uint64_t> workerAffinityMasks;	// worker i is pinned to workerAffinityMasks[i % size()], empty or 0 masks leave the workers unpinned
+		std::string workerName{ "Job Worker" };		// worker i is named "<workerName> <i>"
+		uint64_t clientAffinityMask{ 0 };			// pins the thread calling initialize, 0 leaves it unpinned
+	};
+
+	/**
+	 * Starts the worker threads with one worker per hardware thread, minus one for the client thread.
+	 */
 	static void initialize();
 
+	/**
+	 * Starts the worker threads.
+	 * The thread calling initialize becomes the client thread.
+	 * 
+	 * \param config for worker count, worker names and cpu affinity.
+	 */
+	static void initialize(Config const& config);
+
+	/**
+	 * Stops and joins all workers, then frees the job queues.
+	 * Queued jobs that no worker started are not executed. Called at program exit when the JobSystem is still running.
+	 */
 	static void reset();
 
+	/**
+	 * \return worker count used when Config::workerCount is 0.
+	 */
+	static size_t defaultWorkerCount() { return std::max(std::thread::hardware_concurrency(), 2u) - 1; }
+
 	/**
 	 * \return number of worker threads.
 	 */
 	static size_t workerCount() { return threadCount; }
 
-private:
+	/**
+	 * Jobs can be executed by the workers and by the client thread while it helps in wait.
+	 * The worker thread ids are 0 to workerCount()-1, the client thread has the id workerCount().
+	 * 
+	 * \return number of threads that can execute jobs, use this to size per thread data indexed by the thread id.
+	 */
+	static size_t jobThreadCount() { return threadCount + 1; }
 
 	/**
-	 * removes tag/batch from batches map.
-	 * calls destructor of job batch.
-	 * frees memory of job batch.
+	 * \return id of the calling thread, the same id jobs get in execute.
+	 * Only the client thread and the workers have an id.
+	 */
+	static uint32_t currentThreadId()
+	{
+		assert(tlsQueueIndex >= 0);	// the calling thread does not execute jobs
+		return uint32_t(tlsQueueIndex);
+	}
+
+	/**
+	 * \return maximum number of workers that execute Background jobs at the same time.
+	 */
+	static size_t maxBackgroundWorkers() { return backgroundWorkerLimit; }
+
+	/// 
+	/// COROUTINES:
+	/// the definitions are in JobSystemTask.hpp
+	/// 
+
+	/**
+	 * Coroutine type for multi stage work, see JobSystemTask.hpp.
+	 */
+	template<typename T = void>
+	class Task;
+
+	struct ScheduleAwaiter;
+	struct TagAwaiter;
+
+	/**
+	 * Submits a task to be started in a job.
+	 * The job batch of the returned tag is finished when the coroutine completes, not when it suspends for the first time,
+	 * so the tag can be used like any other tag, for wait, finished, orphan and as a prerequisite.
+	 * Exceptions that escape a submitted task are lost.
+	 * 
+	 * \param task to run, the JobSystem takes the ownership.
+	 * \param priority of the job that starts the task.
+	 * \return tag that is used to identify the task.
+	 */
+	static Tag submitTask(Task<void>&& task, Priority priority = Priority::Normal);
+
+	/**
+	 * co_await JobSystem::schedule(priority) suspends the current task and resumes it in a new job with the given priority.
+	 * It is used to move stages of a task to another priority class, for example io to the background lane.
+	 */
+	static ScheduleAwaiter schedule(Priority priority = Priority::Normal);
+
+	/**
+	 * co_await JobSystem::after(tag) suspends the current task until the job batch of the tag is finished, 
+	 * without blocking a thread. The task is then resumed in a new job with the given priority.
+	 * The tag is consumed.
+	 */
+	static TagAwaiter after(Tag tag, Priority priority = Priority::Normal);
+
+	/// 
+	/// TRACING:
+	/// 
+
+	/**
+	 * Starts recording the execution of every job: begin and end time, thread, batch tag and label (see IJob::traceLabel).
+	 * Every thread records into its own ring buffer, so tracing does not take locks.
+	 * When a buffer is full, the oldest events of the thread are overwritten.
+	 * Events of an earlier trace are discarded.
 	 * 
-	 * \param tag of job to delete.
+	 * Must be called by the client thread while no trace is recorded.
+	 * 
+	 * \param eventsPerThread capacity of the ring buffer of every thread.
+	 */
+	static void beginTrace(size_t eventsPerThread = DEFAULT_TRACE_EVENTS_PER_THREAD);
+
+	/**
+	 * Stops recording jobs. Jobs that are still running when the trace ends are not recorded.
+	 * Must be called by the client thread outside of jobs.
+	 */
+	static void endTrace();
+
+	/**
+	 * \return true between beginTrace and endTrace.
 	 */
-	static void deleteJobBatch(Tag tag);
+	static bool tracing() { return (traceSession.load(std::memory_order_relaxed) & 1) != 0; }
+
+	/**
+	 * Writes the recorded jobs in the chrome trace event format, that can be opened with chrome://tracing or ui.perfetto.dev.
+	 * Every job is a complete event on the track of the thread that executed it.
+	 * Must be called after endTrace.
+	 */
+	static void writeTrace(std::ostream& out);
+
+private:
+
+	struct JobBatch;
+
+	static constexpr size_t JOB_ARENA_BLOCK_SIZE{ 1 << 16 };
+	static constexpr size_t MAX_JOB_ARENA_ALLOCATION{ JOB_ARENA_BLOCK_SIZE / 8 };	// bigger jobs are allocated on the heap
+
+	/**
+	 * Block of a per thread job arena.
+	 * Only the owning thread allocates from its block, by bumping the used offset.
+	 * Every allocation holds a reference to the block, the owning arena holds one more.
+	 * When all allocations of the current block are released, the owner rewinds it, so in a steady state the same block is reused every frame.
+	 * When the block is full while allocations are still alive (for example an orphaned long running job), 
+	 * the owner drops its reference and continues in a new block, the old block is freed by the release of its last allocation.
+	 */
+	struct JobArenaBlock {
+		std::atomic<size_t> refCount{ 1 };
+		size_t used{ 0 };
+		alignas(64) std::byte memory[JOB_ARENA_BLOCK_SIZE];
+	};
+
+	/**
+	 * Node in the continuation list of a prerequisite batch.
+	 * The nodes are stored in the dependent batch, one per prerequisite.
+	 */
+	struct Continuation {
+		JobBatch* dependent;
+		Continuation* next;
+	};
+
+	/**
+	 * One entry in the work stealing queues.
+	 * Records are stored inside their job batch, so they live exactly as long as the batch.
+	 */
+	struct JobRecord {
+		IJob* job{ nullptr };
+		JobBatch* batch{ nullptr };
+	};
 
 	/**
 	 * Contains either a ThreadJob or a vector of ThreadJob's.
+	 * Job batches are pooled and reused, they are never moved in memory.
 	 */
 	struct JobBatch {
-		JobBatch() = default;
-		
-		JobBatch(void* memory, size_t jobCount) :
-			memory{ memory }, jobsLeft{ jobCount }
-		{}
-
 		/**
 		 * Type erased batch memory ptr.
 		 */
@@ -179,22 +525,40 @@ private:
 
 		/**
 		 * The destructor of the job batch will vary as the JobManager uses type erasure to store the job batches memory ptr.
-		 * this std::fucntion stores the destructor of the job container.
-		 * The constructor is called on destruction of the job batch.
+		 * this function pointer stores the destructor of the job container.
+		 * The destructor is called on destruction of the job batch.
+		 */
+		void(*destructor)(void*){ nullptr };
+
+		/**
+		 * Arena block the memory was allocated from, nullptr if it was allocated on the heap.
 		 */
-		std::function<void(void*)> destructor;
+		JobArenaBlock* arenaBlock{ nullptr };
+
+		/**
+		 * One record per job in the batch, the work stealing queues store pointers to these.
+		 * The vector is kept when the batch is recycled, so its capacity is reused by later batches.
+		 */
+		std::vector<JobRecord> records;
 
 		/**
 		 * A batch can contain >= 1 jobs initially.
 		 * As the jobsLeft falls to 0, the job is marked as completed.
 		 */
-		size_t jobsLeft{ 0 };
+		std::atomic<size_t> jobsLeft{ 0 };
+
+		/**
+		 * Every unfinished job holds a reference to the batch, the client holds one more until it calls wait, finished or orphan.
+		 * The batch is released when the last reference is dropped.
+		 * This way an orphaned batch is released by the worker that finishes its last job, without any further synchronisation.
+		 */
+		std::atomic<size_t> refCount{ 0 };
 
 		/**
-		 * For an orphan job batch, the tag is no longer available for other calls like finished(Tag) or wait(tag).
-		 * orphaned job batch's memory will be released immediately after the job is finished.
+		 * Incremented every time the batch is released.
+		 * A Tag contains the generation of the batch it was created for, so outdated tags can be detected.
 		 */
-		bool bOrphaned{ false };
+		std::atomic<uint32_t> generation{ 0 };
 
 		/**
 		 * If a thread waits for a job batch to finish it is marked by this flag.
@@ -202,9 +566,182 @@ private:
 		 * This gives us the advantage that we only notify the clientCV, when the right client is waiting.
 		 * We dont want to notify every client for every completed job, wich would cause a lot of contention on the mutex.
 		 */
-		bool bWaitedFor{ false };
+		std::atomic<bool> bWaitedFor{ false };
+
+		Priority priority{ Priority::Normal };
+
+		/**
+		 * Count of unfinished prerequisites, plus one that is held while the prerequisites are registered.
+		 * When it falls to 0 the records are pushed into the queues.
+		 * Until then the batch counts one pseudo job in jobsLeft and refCount, so it can not finish or be released early.
+		 */
+		std::atomic<uint32_t> unfinishedPrerequisites{ 0 };
+
+		/**
+		 * Lock free list of the batches that wait for this batch to finish.
+		 * On completion the list is swapped with the closedContinuations sentinel, later dependents see that and do not wait.
+		 */
+		std::atomic<Continuation*> continuations{ nullptr };
+
+		/**
+		 * Storage for the continuation nodes this batch links into the lists of its prerequisites.
+		 * Like the records, the capacity is reused when the batch is recycled.
+		 */
+		std::vector<Continuation> continuationNodes;
+
+		/**
+		 * Index of the batch in the batch pool.
+		 */
+		uint32_t poolIndex{ 0 };
+	};
+
+	/**
+	 * Takes a batch out of the pool and initializes it for jobCount jobs.
+	 * 
+	 * \return the tag for the batch and the batch itself.
+	 */
+	static std::pair<Tag, JobBatch*> allocateJobBatch(void* memory, void(*destructor)(void*), JobArenaBlock* arenaBlock, size_t jobCount, Priority priority);
+
+	/**
+	 * Allocates memory for a job from the arena of the current thread.
+	 * Falls back to the heap for threads that own no arena, for big jobs and for long lived jobs 
+	 * (Background jobs and tasks), as these would keep the arena block alive.
+	 * 
+	 * \return the memory and the arena block it was taken from, nullptr for heap memory.
+	 */
+	static std::pair<void*, JobArenaBlock*> allocateJobMemory(size_t size, size_t alignment, bool bLongLived);
+
+	/**
+	 * Frees memory allocated with allocateJobMemory, can be called from any thread.
+	 */
+	static void freeJobMemory(void* memory, JobArenaBlock* arenaBlock);
+
+	/**
+	 * Job that executes parallelForRange.
+	 * All records of its batch point to the same job, every execution takes chunks from the shared cursor until the range is exhausted.
+	 */
+	template<typename RangeFunc>
+	class ParallelForJob : public IJob {
+	public:
+		ParallelForJob(size_t begin, size_t end, size_t grainSize, RangeFunc& func, char const* label) :
+			cursor{ begin }, end{ end }, grainSize{ grainSize }, func{ func }, label{ label }
+		{}
+
+		virtual char const* traceLabel() const override { return label; }
+
+		virtual void execute(const uint32_t threadId) override
+		{
+			const size_t threads = jobThreadCount();
+			size_t chunkBegin = cursor.load(std::memory_order_relaxed);
+			while (chunkBegin < end) {
+				const size_t remaining = end - chunkBegin;
+				const size_t chunkSize = std::min(remaining, std::max(grainSize, remaining / (2 * threads)));
+				if (cursor.compare_exchange_weak(chunkBegin, chunkBegin + chunkSize, std::memory_order_relaxed)) {
+					func(chunkBegin, chunkBegin + chunkSize, threadId);
+					chunkBegin = cursor.load(std::memory_order_relaxed);
+				}
+			}
+		}
+	private:
+		std::atomic<size_t> cursor;
+		const size_t end;
+		const size_t grainSize;
+		RangeFunc& func;
+		char const* label;
 	};
 
+	/**
+	 * Submits a job that is owned by the caller and executed executionCount times, possibly at the same time.
+	 * The batch does not destroy or free the job, so the caller must keep it alive until the batch is finished.
+	 */
+	static Tag submitShared(IJob* job, size_t executionCount);
+
+	/**
+	 * Links the batch into the continuation lists of its prerequisites.
+	 * The batch is pushed immediately when all prerequisites are already finished.
+	 */
+	static void scheduleJobBatch(JobBatch* batch, std::span<const Tag> prerequisites);
+
+	/**
+	 * Called once for each finished prerequisite of the batch.
+	 * The last call pushes the batch and finishes its pseudo job.
+	 */
+	static void prerequisiteFinished(JobBatch* batch);
+
+	/**
+	 * Pushes all job records of the batch into the queue of the current thread and wakes up sleeping workers.
+	 */
+	static void pushJobBatch(JobBatch* batch);
+
+	/**
+	 * Marks one job of the batch as finished and drops its reference.
+	 * When it was the last job, the dependent batches are notified and waiting clients are woken up.
+	 */
+	static void finishJob(JobBatch* batch);
+
+	/**
+	 * \return batch for the given tag or nullptr, if the tag is outdated.
+	 */
+	static JobBatch* getJobBatch(Tag tag);
+
+	/**
+	 * Drops one reference to the batch.
+	 * When the last reference is dropped:
+	 * calls destructor of job batch.
+	 * frees memory of job batch.
+	 * returns the batch to the pool, this invalidates its tag.
+	 * 
+	 * \param batch to release.
+	 */
+	static void releaseJobBatch(JobBatch* batch);
+
+	/**
+	 * Executes the job of the record and marks it as completed in its batch.
+	 */
+	static void executeJob(JobRecord* record, const uint32_t threadId);
+
+	/**
+	 * Executes a job and records it into the trace of the thread.
+	 */
+	static void executeTracedJob(JobRecord* record, const uint32_t threadId, uint64_t session);
+
+	/**
+	 * \return nanoseconds since the steady clock's epoch.
+	 */
+	static int64_t steadyTimeNs() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+	/**
+	 * \return nanoseconds since the trace began.
+	 */
+	static int64_t traceTime() { return steadyTimeNs() - traceStart.load(std::memory_order_relaxed); }
+
+	/**
+	 * Tries to take a job from the own queue, the injection queue or to steal one from another thread.
+	 * FrameCritical jobs are searched first, then Normal jobs, then Background jobs if allowed.
+	 * 
+	 * \param queueIndex index of the own queue, -1 for threads that own no queue.
+	 * \param bAllowBackground if Background jobs may be taken.
+	 * \return a job record or nullptr if no job was found.
+	 */
+	static JobRecord* findJob(int64_t queueIndex, bool bAllowBackground);
+
+	/**
+	 * Takes a job from the background lane, if fewer than backgroundWorkerLimit background jobs are running.
+	 * 
+	 * \return a job record or nullptr if no job was taken.
+	 */
+	static JobRecord* takeBackgroundJob();
+
+	/**
+	 * \return true if a worker could take a background job right now.
+	 */
+	static bool backgroundJobAvailable();
+
+	/**
+	 * Wakes up sleeping workers after jobs were queued.
+	 */
+	static void notifyWorkers(size_t jobCount);
+
 	static void workerFunction(const uint32_t id);
 
 	// used to check for uninitialized use
@@ -212,17 +749,74 @@ private:
 		Uninitialized,
 		Running
 	};
-	inline static const size_t threadCount{ std::max(std::thread::hardware_concurrency()-1, 1u) };	// the worker count is only n-1 hardwarethreads, as we dont want to pollute the os with threads.
+	inline static size_t threadCount{ defaultWorkerCount() };		// set in initialize, by default only n-1 hardwarethreads, as we dont want to pollute the os with threads.
 	inline static std::vector<std::thread> threads;
+	inline static std::atomic<State> state{ State::Uninitialized };									// used for checking uninitialized use
+
+	/// 
+	/// JOB QUEUES:
+	/// 
+	static constexpr size_t QUEUED_PRIORITY_COUNT{ 2 };	// FrameCritical and Normal, Background jobs are kept in the background lane
+	using QueueList = std::vector<std::unique_ptr<WorkStealingQueue<JobRecord*>>>;
+	inline static std::array<QueueList, QUEUED_PRIORITY_COUNT> queues;							// one per worker, the last one belongs to the client thread
+	inline static thread_local int64_t tlsQueueIndex{ -1 };										// index of the queue the current thread owns, -1 if it owns none
+	inline static std::mutex injectionMut;														// guards the injection queues
+	inline static std::array<std::deque<JobRecord*>, QUEUED_PRIORITY_COUNT> injectionQueues;		// jobs submitted by threads that own no queue
+	inline static std::array<std::atomic<size_t>, QUEUED_PRIORITY_COUNT> injectionQueueSizes{};	// lets workers skip the injection mutex when the queue is empty
+
+	/// 
+	/// BACKGROUND LANE:
+	/// 
+	inline static size_t backgroundWorkerLimit{ 1 };		// set in initialize, a quarter of the workers
+	inline static std::mutex backgroundMut;
+	inline static std::deque<JobRecord*> backgroundQueue;
+	inline static std::atomic<size_t> backgroundQueueSize{ 0 };
+	inline static std::atomic<size_t> runningBackgroundJobs{ 0 };
+
+	/// 
+	/// JOB MEMORY:
+	/// 
+	inline static std::vector<JobArenaBlock*> arenaBlocks;								// current arena block of every thread that owns a queue, indexed like the queues
+
+	/// 
+	/// WORKER SLEEPING:
+	/// 
+	inline static std::atomic<int64_t> queuedJobs{ 0 };			// count of FrameCritical and Normal jobs in all queues, workers only go to sleep when it is 0 and no background job can be taken
+	inline static std::atomic<uint32_t> sleepingWorkers{ 0 };	// submitters only take the sleepMut when there are workers to wake
+	inline static std::mutex sleepMut;
+	inline static std::condition_variable workerCV;				// cv used by the worker threads to get informed when jobs is in queue
+	static constexpr uint32_t SPINS_BEFORE_SLEEP{ 64 };			// count of failed attempts to find a job before a worker goes to sleep
+	static constexpr size_t AUTO_GRAIN_CHUNKS_PER_THREAD{ 16 };	// used by autoGrainSize
 
-	inline static std::mutex mut;						// central syncronization mutex used for every read wnad write to the fields below:
 	/// 
-	/// THE FOLLOWING FIELDS ARE GUARDED BY THE MUTEX MUT:
+	/// WAITING CLIENTS:
 	/// 
-	inline static State state{ State::Uninitialized };												// used for checking uninitialized use
-	inline static std::condition_variable workerCV;		// cv used by the worker threads to get informed when jobs is in queue
-	inline static std::condition_variable clientCV;		// cv used by threads that are waiting for a job batch to be finished
-	inline static Tag nextJobTag{ 0 };					// Job tags are created sequentially, beginning at 0 after application start.
-	inline static std::deque<std::pair<Tag, IJob*>> jobQueue;
-	inline static std::unordered_map<Tag, JobBatch> batches;
-};
\ No newline at end of file
+	inline static std::mutex waitMut;
+	inline static std::condition_variable clientCV;				// cv used by threads that are waiting for a job batch to be finished
+
+	/// 
+	/// TRACING:
+	/// 
+	static constexpr size_t DEFAULT_TRACE_EVENTS_PER_THREAD{ 1 << 16 };
+	inline static std::atomic<uint64_t> traceSession{ 0 };				// incremented by beginTrace and endTrace, odd while tracing
+	inline static std::atomic<uint32_t> pushingTraceThreads{ 0 };		// threads that are currently pushing an event, endTrace waits for them
+	inline static std::atomic<int64_t> traceStart{ 0 };				// see steadyTimeNs, atomic as jobs of an ended trace may still read it
+	inline static std::vector<std::unique_ptr<JobTraceBuffer>> traceBuffers;	// one per thread id
+	inline static std::vector<std::string> threadNames;					// one per thread id, set in initialize
+
+	/// 
+	/// JOB BATCH POOL:
+	/// 
+	static constexpr uint32_t BATCH_PAGE_BITS{ 6 };
+	static constexpr uint32_t BATCH_PAGE_SIZE{ 1 << BATCH_PAGE_BITS };
+	static constexpr uint32_t BATCH_OFFSET_MASK{ BATCH_PAGE_SIZE - 1 };
+	static constexpr uint32_t BATCH_PAGE_COUNT{ 1024 };
+	struct JobBatchPage {
+		std::array<JobBatch, BATCH_PAGE_SIZE> batches;
+	};
+	inline static std::mutex batchPoolMut;												// guards the free list and page creation, taken once per batch, never per job
+	inline static std::array<std::unique_ptr<JobBatchPage>, BATCH_PAGE_COUNT> batchPages;	// page pointers are never changed after creation, so reads need no lock
+	inline static std::vector<uint32_t> freeBatchIndices;
+	inline static Continuation closedContinuations;										// sentinel that marks the continuation list of a finished batch
+	inline static uint32_t nextBatchIndex{ 0 };
+};
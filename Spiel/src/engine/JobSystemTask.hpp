@@ -0,0 +1,215 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "JobSystem.hpp"
+
+/**
+ * Job that resumes a suspended coroutine.
+ */
+class CoroutineResumeJob : public IJob {
+public:
+	CoroutineResumeJob(std::coroutine_handle<> handle) : handle{ handle } {}
+	virtual void execute(const uint32_t threadId) override
+	{
+		handle.resume();
+	}
+private:
+	std::coroutine_handle<> handle;
+};
+
+/**
+ * Stores the value a task returns with co_return.
+ */
+template<typename T>
+struct JobSystemTaskResult {
+	template<typename U>
+	void return_value(U&& value)
+	{
+		result.emplace(std::forward<U>(value));
+	}
+
+	T takeResult()
+	{
+		return std::move(*result);
+	}
+
+	std::optional<T> result;
+};
+
+template<>
+struct JobSystemTaskResult<void> {
+	void return_void() {}
+	void takeResult() {}
+};
+
+/**
+ * Coroutine that runs on the threads of the JobSystem.
+ *
+ * A task is lazy, it only starts when it is awaited by another task or when it is submitted with JobSystem::submitTask.
+ * An awaited task runs on the thread of the awaiting task, the awaiting task continues when the awaited task completes.
+ * Inside a task, co_await JobSystem::after(tag) waits for job batches and co_await JobSystem::schedule(priority) changes the priority class,
+ * both suspend the task without blocking a thread. So multi stage work can be written as one function:
+ *
+ * JobSystem::Task<std::string> readFile(std::string path)
+ * {
+ *	co_await JobSystem::schedule(JobSystem::Priority::Background);
+ *	...
+ *	co_return content;
+ * }
+ *
+ * A task is only allowed to be awaited once.
+ */
+template<typename T>
+class JobSystem::Task {
+public:
+	struct promise_type;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	/**
+	 * Resumes the awaiting task when the task completes.
+	 * A submitted task has no awaiting task, it reports its completion to the JobSystem instead.
+	 */
+	struct FinalAwaiter {
+		bool await_ready() noexcept { return false; }
+
+		std::coroutine_handle<> await_suspend(Handle handle) noexcept
+		{
+			promise_type& promise = handle.promise();
+			if (promise.continuation) {
+				return promise.continuation;
+			}
+			if (promise.onComplete) {
+				// this can destroy the coroutine, so the promise must not be used afterwards:
+				auto onComplete = promise.onComplete;
+				void* context = promise.onCompleteContext;
+				onComplete(context);
+			}
+			return std::noop_coroutine();
+		}
+
+		void await_resume() noexcept {}
+	};
+
+	struct promise_type : JobSystemTaskResult<T> {
+		Task get_return_object()
+		{
+			return Task{ Handle::from_promise(*this) };
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		void unhandled_exception()
+		{
+			exception = std::current_exception();
+		}
+
+		T result()
+		{
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+			return this->takeResult();
+		}
+
+		std::coroutine_handle<> continuation;
+		std::exception_ptr exception;
+
+		// set by JobSystem::submitTask:
+		void(*onComplete)(void*){ nullptr };
+		void* onCompleteContext{ nullptr };
+	};
+
+	/**
+	 * Starts the awaited task on the current thread and resumes the awaiting task when it completes.
+	 */
+	struct Awaiter {
+		bool await_ready() noexcept
+		{
+			return handle.done();
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		T await_resume()
+		{
+			return handle.promise().result();
+		}
+
+		Handle handle;
+	};
+
+	Task(Task&& other) noexcept :
+		handle{ std::exchange(other.handle, nullptr) }
+	{}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other) {
+			if (handle) handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+
+	Task(Task const&) = delete;
+	Task& operator=(Task const&) = delete;
+
+	~Task()
+	{
+		if (handle) handle.destroy();
+	}
+
+	Awaiter operator co_await() noexcept
+	{
+		assert(handle);
+		return Awaiter{ handle };
+	}
+
+private:
+	friend class JobSystem;
+
+	explicit Task(Handle handle) : handle{ handle } {}
+
+	Handle handle;
+};
+
+struct JobSystem::ScheduleAwaiter {
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> handle) const
+	{
+		// the task can be resumed and finish before submit returns, so the awaiter must not be used after it:
+		JobSystem::orphan(JobSystem::submit(CoroutineResumeJob(handle), priority));
+	}
+
+	void await_resume() const noexcept {}
+
+	Priority priority;
+};
+
+struct JobSystem::TagAwaiter {
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> handle) const
+	{
+		// the task can be resumed and finish before submit returns, so the awaiter must not be used after it:
+		const Tag prerequisite = tag;
+		JobSystem::orphan(JobSystem::submit(CoroutineResumeJob(handle), { prerequisite }, priority));
+		JobSystem::orphan(prerequisite);
+	}
+
+	void await_resume() const noexcept {}
+
+	Tag tag;
+	Priority priority;
+};
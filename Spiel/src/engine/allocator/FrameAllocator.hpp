@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <new>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Linear allocator for memory that only lives until the end of the current frame.
+ *
+ * Every thread allocates from its own list of chunks, so allocating is a pointer bump without any synchronization.
+ * Chunks are kept over frames and reused, after the first frames no new memory is requested from the system.
+ * endFrame() only increments a frame counter, each thread resets its own arena at its next allocation when it sees a new frame.
+ *
+ * Memory may be handed to and freed by other threads, but it must not be used after endFrame() was called.
+ * So endFrame() may only be called when no job still uses frame memory, the engine calls it at the end of every main loop iteration.
+ */
+class FrameArena {
+public:
+	static constexpr size_t CHUNK_SIZE{ 1 << 16 };	// 64 KB
+
+	/**
+	 * \return memory for bytes with the given alignment, that is valid until the next call to endFrame().
+	 */
+	static void* allocate(size_t bytes, size_t alignment)
+	{
+		return local().allocate(bytes, alignment, frame.load(std::memory_order_acquire));
+	}
+
+	/**
+	 * Only gives memory back if it is the last allocation of this thread's arena, as it happens when a vector grows or is destroyed right after it was filled.
+	 * All other memory is freed with the next reset, so deallocating memory of an other thread is allowed and does nothing.
+	 */
+	static void deallocate(void* ptr, size_t bytes)
+	{
+		local().deallocate(static_cast<std::byte*>(ptr), bytes, frame.load(std::memory_order_acquire));
+	}
+
+	/**
+	 * Marks all memory allocated by any thread in this frame as free.
+	 */
+	static void endFrame()
+	{
+		frame.fetch_add(1, std::memory_order_release);
+	}
+
+	/**
+	 * \return bytes of the calling thread's arena that are allocated in the current frame.
+	 */
+	static size_t bytesInUse()
+	{
+		ThreadArena& arena = local();
+		if (arena.frame != frame.load(std::memory_order_acquire)) return 0;
+		size_t bytes{ 0 };
+		for (size_t i = 0; i < arena.current && i < arena.chunks.size(); ++i) {
+			bytes += arena.chunks[i].size;
+		}
+		return bytes + arena.offset;
+	}
+
+	/**
+	 * \return bytes that the calling thread's arena holds, including the ones that are free.
+	 */
+	static size_t bytesReserved()
+	{
+		size_t bytes{ 0 };
+		for (auto const& chunk : local().chunks) {
+			bytes += chunk.size;
+		}
+		return bytes;
+	}
+
+private:
+	struct Chunk {
+		std::unique_ptr<std::byte[]> data;
+		size_t size{ 0 };
+	};
+
+	struct ThreadArena {
+		void* allocate(size_t bytes, size_t alignment, uint64_t currentFrame)
+		{
+			if (frame != currentFrame) {
+				frame = currentFrame;
+				current = 0;
+				offset = 0;
+			}
+
+			if (current < chunks.size()) {
+				if (void* ptr = bump(chunks[current], bytes, alignment)) {
+					return ptr;
+				}
+				++current;
+				offset = 0;
+			}
+
+			// the chunks after the current one are free, use the next one if it is big enough or put a new one in front of it:
+			if (current >= chunks.size() || chunks[current].size < bytes + alignment) {
+				const size_t size = std::max(CHUNK_SIZE, bytes + alignment);
+				chunks.insert(chunks.begin() + current, Chunk{ std::make_unique<std::byte[]>(size), size });
+			}
+			return bump(chunks[current], bytes, alignment);
+		}
+
+		void deallocate(std::byte* ptr, size_t bytes, uint64_t currentFrame)
+		{
+			if (frame != currentFrame || current >= chunks.size()) return;
+			std::byte* const begin = chunks[current].data.get();
+			if (ptr >= begin && ptr + bytes == begin + offset) {
+				offset = size_t(ptr - begin);
+			}
+		}
+
+		void* bump(Chunk& chunk, size_t bytes, size_t alignment)
+		{
+			const uintptr_t begin = reinterpret_cast<uintptr_t>(chunk.data.get());
+			const uintptr_t aligned = (begin + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+			if (aligned + bytes > begin + chunk.size) return nullptr;
+			offset = size_t(aligned + bytes - begin);
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		std::vector<Chunk> chunks;
+		size_t current{ 0 };	// chunk that is allocated from, all chunks after it are free
+		size_t offset{ 0 };		// first free byte in the current chunk
+		uint64_t frame{ 0 };	// frame the allocations in the chunks belong to
+	};
+
+	static ThreadArena& local()
+	{
+		thread_local ThreadArena arena;
+		return arena;
+	}
+
+	static inline std::atomic<uint64_t> frame{ 0 };
+};
+
+/**
+ * STL allocator that allocates from the FrameArena, for containers that are thrown away in the frame they were made in.
+ */
+template<typename T>
+class FrameAllocator {
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using propagate_on_container_move_assignment = std::true_type;
+	using is_always_equal = std::true_type;
+
+	FrameAllocator() noexcept = default;
+	template<typename U>
+	FrameAllocator(FrameAllocator<U> const&) noexcept {}
+
+	T* allocate(size_type count)
+	{
+		if (count > std::numeric_limits<size_type>::max() / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(FrameArena::allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void deallocate(T* ptr, size_type count) noexcept
+	{
+		FrameArena::deallocate(ptr, sizeof(T) * count);
+	}
+
+	template<typename U>
+	bool operator==(FrameAllocator<U> const&) const noexcept { return true; }
+	template<typename U>
+	bool operator!=(FrameAllocator<U> const&) const noexcept { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -8,9 +8,7 @@ CollisionSystem::CollisionSystem(CollisionSECM secm, uint32_t qtreeCapacity) :
 	qtreeParticle({ 0,0 }, { 0,0 }, qtreeCapacity, secm, Collider::PARTICLE),
 	qtreeSensor({ 0,0 }, { 0,0 }, qtreeCapacity, secm, Collider::SENSOR)
 {
-	jobEntityBuffers.push_back(std::make_unique<std::vector<EntityHandleIndex>>());
-
-	for (int i = 0; i < JobSystem::workerCount(); i++) {
+	for (int i = 0; i < JobSystem::jobThreadCount(); i++) {
 		collisionLists.push_back(std::vector<CollisionInfo>());
 	}
 }
@@ -44,8 +42,8 @@ const std::vector<Sprite>& CollisionSystem::getDebugSprites() const
 void CollisionSystem::checkForCollisions(std::vector<CollisionInfo>& collisions, uint8_t colliderType, Transform const& b, Collider const& c) const
 {
 	Vec2 aabb = aabbBounds(c.size, b.rotaVec);
-	std::vector<EntityHandleIndex> near;
-	std::vector<QtreeNodeQuerry> buffer;
+	FrameVector<EntityHandleIndex> near;
+	FrameVector<QtreeNodeQuerry> buffer;
 	if (colliderType & Collider::DYNAMIC) {
 		qtreeDynamic.querry(near, buffer, b.position, aabb);
 	}
@@ -58,7 +56,7 @@ void CollisionSystem::checkForCollisions(std::vector<CollisionInfo>& collisions,
 	if (colliderType & Collider::SENSOR) {
 		qtreeSensor.querry(near, buffer, b.position, aabb);
 	}
-	std::vector<CollPoint> verteciesBuffer;
+	FrameVector<CollPoint> verteciesBuffer;
 	generateCollisionInfos2(secm, collisions, aabbCache, near, INVALID_ENTITY_HANDLE_INDEX, b, c, aabb, verteciesBuffer);
 }
 
@@ -163,119 +161,72 @@ void CollisionSystem::cleanBuffers(CollisionSECM secm)
 	for (auto& collisionList : collisionLists) {
 		collisionList.clear();
 	}
-	for (auto& jobBuffer : jobEntityBuffers) {
-		jobBuffer->clear();
-	}
 }
 
 void CollisionSystem::collisionDetection(CollisionSECM secm)
 {
-	class CollJob : public IJob {
-	public:
-
-		CollJob(
-			CollisionSECM subecm,
-			StaticVector<Quadtree const*, 4> qtrees,
-			std::vector<Vec2> const* aabbCache,
-			std::vector<std::vector<CollisionInfo>>* collInfos)
-			:
-			subecm{ subecm },
-			qtrees{ qtrees },
-			aabbCache{ aabbCache },
-			collInfos{ collInfos }
-		{}
-
-		void execute(const uint32_t thread) override
-		{
-			auto checkForCollisions = [&](EntityHandleIndex ent, Quadtree const& qtree) {
-				const auto& baseColl = subecm.getComp<Transform>(ent);
-				const auto& colliderColl = subecm.getComp<Collider>(ent);
-
-				nearEntitiesBuffer.clear();
-				qtreeQuerryBuffer.clear();
-				collPoints.clear();
-
-				//if (!colliderColl.sleeping) {
-					qtree.querry(nearEntitiesBuffer, qtreeQuerryBuffer, baseColl.position, aabbCache->at(ent));
-
-					generateCollisionInfos2(subecm, collInfos->at(thread), *aabbCache, nearEntitiesBuffer, ent, baseColl, colliderColl, aabbCache->at(ent), collPoints);
-				//}
-			};
-
-			for (int i = 0; i < entities.size(); ++i) {
-				EntityHandleIndex ent = entities[i];
-
-				Collider const& entColliderComp = subecm.getComp<Collider>(ent);
-
-				for (int j = 0; j < qtrees.size(); ++j) {
-					Quadtree const* qtree = qtrees[j];
-
-					if (!entColliderComp.isIgnoring(qtree->COLLIDER_TAG)) {
-						checkForCollisions(ent, *qtree);
-					}
-				}
-			}
-		}
-
-		StaticVector<EntityHandleIndex, MAX_ENTITIES_PER_JOB> entities;
-	private:
-		std::vector<std::vector<CollisionInfo>>* collInfos;
+	struct CheckGroup {
+		std::vector<EntityHandleIndex> const* entities;
 		StaticVector<Quadtree const*, 4> qtrees;
-		CollisionSECM subecm;
-		std::vector<Vec2> const* aabbCache;
-
-		// buffers for queriing:
-		std::vector<EntityHandleIndex> nearEntitiesBuffer;
-		std::vector<QtreeNodeQuerry> qtreeQuerryBuffer;
-		std::vector<CollPoint> collPoints;
 	};
 
-	std::vector<CollJob> jobs;
-	jobs.reserve(200);
-
-	auto createCollisionCheckJobs = [&](const std::vector<EntityHandleIndex>& entities, const uint8_t qtreeMask) {
-
-		StaticVector<Quadtree const*, 4> qtrees;
-		if (qtreeDynamic.COLLIDER_TAG & qtreeMask) { qtrees.push_back(&qtreeDynamic); }
-		if (qtreeStatic.COLLIDER_TAG & qtreeMask) { qtrees.push_back(&qtreeStatic); }
-		if (qtreeParticle.COLLIDER_TAG & qtreeMask) { qtrees.push_back(&qtreeParticle); }
-		if (qtreeSensor.COLLIDER_TAG & qtreeMask) { qtrees.push_back(&qtreeSensor); }
-
-		const auto newCollJob = CollJob(
-			secm,
-			qtrees,
-			&aabbCache,
-			&collisionLists
-		);
-
-		auto c = newCollJob;
-
-		// cut up entities vector into smaller parts (MAX SIZE = MAX_ENTITIES_PER_JOB) 
-		// and save them i the jobs vector
-		for (auto el : entities) {
-			c.entities.push_back(el);
-			if (c.entities.size() == MAX_ENTITIES_PER_JOB) {
-				jobs.push_back(c);
-				c = newCollJob;
-			}
-		}
-		// dont forget the last job that potentially only has less entities than MAX_ENTITIES_PER_JOB!:
-		if (c.entities.size() > 0) {
-			jobs.push_back(c);
-		}
+	auto makeCheckGroup = [&](const std::vector<EntityHandleIndex>& entities, const uint8_t qtreeMask) {
+		CheckGroup group{ &entities };
+		if (qtreeDynamic.COLLIDER_TAG & qtreeMask) { group.qtrees.push_back(&qtreeDynamic); }
+		if (qtreeStatic.COLLIDER_TAG & qtreeMask) { group.qtrees.push_back(&qtreeStatic); }
+		if (qtreeParticle.COLLIDER_TAG & qtreeMask) { group.qtrees.push_back(&qtreeParticle); }
+		if (qtreeSensor.COLLIDER_TAG & qtreeMask) { group.qtrees.push_back(&qtreeSensor); }
+		return group;
 	};
 
-	createCollisionCheckJobs(particleEntities, Collider::DYNAMIC | Collider::STATIC);
-
-	createCollisionCheckJobs(dynamicSolidEntities, Collider::DYNAMIC | Collider::STATIC);
-
-	createCollisionCheckJobs(staticSolidEntities, Collider::DYNAMIC);
-
-	createCollisionCheckJobs(sensorEntities, Collider::PARTICLE | Collider::DYNAMIC | Collider::SENSOR | Collider::STATIC);
+	const std::array<CheckGroup, 4> groups{
+		makeCheckGroup(particleEntities, Collider::DYNAMIC | Collider::STATIC),
+		makeCheckGroup(dynamicSolidEntities, Collider::DYNAMIC | Collider::STATIC),
+		makeCheckGroup(staticSolidEntities, Collider::DYNAMIC),
+		makeCheckGroup(sensorEntities, Collider::PARTICLE | Collider::DYNAMIC | Collider::SENSOR | Collider::STATIC)
+	};
 
-	auto tag = JobSystem::submitVec(std::move(jobs));
+	size_t entityCount{ 0 };
+	for (auto const& group : groups) {
+		entityCount += group.entities->size();
+	}
 
-	JobSystem::wait(tag);
+	// all groups are checked as one continuous index range, so the load is balanced over all of them:
+	JobSystem::parallelForRange(0, entityCount,
+		[&](size_t begin, size_t end, u32 thread) {
+			auto& collInfos = collisionLists[thread];
+			FrameVector<EntityHandleIndex> nearEntities;
+			FrameVector<QtreeNodeQuerry> qtreeQuerry;
+			FrameVector<CollPoint> collPoints;
+
+			size_t groupBegin{ 0 };
+			for (auto const& group : groups) {
+				const size_t groupEnd = groupBegin + group.entities->size();
+				for (size_t i = std::max(begin, groupBegin); i < std::min(end, groupEnd); ++i) {
+					const EntityHandleIndex ent = (*group.entities)[i - groupBegin];
+					const auto& baseColl = secm.getComp<Transform>(ent);
+					const auto& colliderColl = secm.getComp<Collider>(ent);
+
+					for (u32 j = 0; j < group.qtrees.size(); ++j) {
+						Quadtree const* qtree = group.qtrees[j];
+
+						if (!colliderColl.isIgnoring(qtree->COLLIDER_TAG)) {
+							nearEntities.clear();
+							qtreeQuerry.clear();
+							collPoints.clear();
+
+							qtree->querry(nearEntities, qtreeQuerry, baseColl.position, aabbCache.at(ent));
+
+							generateCollisionInfos2(secm, collInfos, aabbCache, nearEntities, ent, baseColl, colliderColl, aabbCache.at(ent), collPoints);
+						}
+					}
+				}
+				groupBegin = groupEnd;
+			}
+		},
+		0,
+		"collisionDetection"
+	);
 
 	// reset quadtree rebuild flags
 	rebuildStatic = false;
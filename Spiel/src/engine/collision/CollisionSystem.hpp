@@ -104,7 +104,6 @@ private:
 
 	CollisionSECM secm;
 	// constants:
-	static const int MAX_ENTITIES_PER_JOB = 200;
 	uint32_t qtreeCapacity;
 	bool rebuildStaticData;
 	// flags:
@@ -125,6 +124,4 @@ private:
 	std::vector<std::vector<CollisionInfo>> collisionLists;
 
 	std::vector<CollisionInfo> dummy{ {} };
-
-	std::vector<std::unique_ptr<std::vector<EntityHandleIndex>>> jobEntityBuffers;
 };
@@ -10,10 +10,16 @@
 	PhysicsBody, \
 	CollisionsToken
 
+/**
+ * The components the collision and physics systems iterate together are stored in one archetype storage,
+ * ECMs that use the CollisionSystem must use this storage for them.
+ */
+using PhysicsArchetype = ComponentStorageArchetype<Transform, Movement, Collider, PhysicsBody>;
+
 using CollisionSECM = EntityComponentManagerView <
-	ComponentStoragePagedIndexing<Transform>,
-	ComponentStoragePagedIndexing<Movement>,
-	ComponentStoragePagedIndexing<Collider>,
-	ComponentStoragePagedIndexing<PhysicsBody>,
+	PhysicsArchetype::Column<Transform>,
+	PhysicsArchetype::Column<Movement>,
+	PhysicsArchetype::Column<Collider>,
+	PhysicsArchetype::Column<PhysicsBody>,
 	ComponentStoragePagedIndexing<CollisionsToken>
 >;
\ No newline at end of file
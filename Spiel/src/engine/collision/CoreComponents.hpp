@@ -2,6 +2,7 @@
 #include "../../engine/types/BaseTypes.hpp"
 #include "../../engine/math/Vec.hpp"
 #include "../../engine/entity/EntityComponentStorage.hpp"
+#include "../../engine/entity/EntityManager.hpp"
 #include "../../engine/types/Timing.hpp"
 #include "../../engine/rendering/OpenGLAbstraction/OpenGLTexture.hpp"
 
@@ -26,6 +27,39 @@ struct Transform {
 	RotaVec2 rotaVec;
 };
 
+/**
+ * Attaches an entity to a parent entity, the TransformHierarchySystem then computes the entity's Transform from
+ * the parent's Transform and the entity's LocalTransform. Both entities need a Transform.
+ */
+struct Parent {
+	Parent(EntityHandle entity = EntityHandle()) :
+		entity{ entity }
+	{}
+
+	/**
+	 * Called by EntityComponentManager::compact.
+	 */
+	void remapEntityHandles(EntityRemap const& remap)
+	{
+		entity = remap(entity);
+	}
+
+	EntityHandle entity;
+};
+
+/**
+ * Transform of an entity relative to its Parent.
+ */
+struct LocalTransform {
+	LocalTransform(Vec2 pos = Vec2{ 0,0 }, RotaVec2 rota = RotaVec2()) :
+		position{ pos },
+		rotaVec{ rota }
+	{}
+
+	Vec2 position;
+	RotaVec2 rotaVec;
+};
+
 struct Movement {
 	Movement(Vec2 vel = { 0,0 }, float anglVel = 0.0f) :
 		velocity{ vel },
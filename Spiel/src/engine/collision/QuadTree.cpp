@@ -120,7 +120,7 @@ constexpr std::pair<float, float> iToFactor(int i)
 }
 
 void Quadtree::broadInsert(
-	std::vector<uint32_t>&& entities,
+	FrameVector<uint32_t>&& entities,
 	const std::vector<Vec2>& aabbs, 
 	const uint32_t thisID, 
 	const Vec2 thisPos, 
@@ -140,10 +140,10 @@ void Quadtree::broadInsert(
 		}
 
 		std::array entityLists{
-			std::vector<uint32_t>(),
-			std::vector<uint32_t>(),
-			std::vector<uint32_t>(),
-			std::vector<uint32_t>()
+			FrameVector<uint32_t>(),
+			FrameVector<uint32_t>(),
+			FrameVector<uint32_t>(),
+			FrameVector<uint32_t>()
 		};
 		auto& ul = entityLists[0];
 		auto& ur = entityLists[1];
@@ -181,7 +181,7 @@ void Quadtree::broadInsert(
 						Quadtree& qtree,
 						std::vector<Vec2> const& aabbs,
 						uint32_t thisID,
-						std::vector<uint32_t>&& entities,
+						FrameVector<uint32_t>&& entities,
 						int i,
 						float xFactor,
 						float yFactor,
@@ -218,7 +218,7 @@ void Quadtree::broadInsert(
 					Quadtree& qtree;
 					std::vector<Vec2> const& aabbs;
 					uint32_t thisID;
-					std::vector<uint32_t> entities;
+					FrameVector<uint32_t> entities;
 					int i;
 					float xFactor;
 					float yFactor;
@@ -257,7 +257,7 @@ void Quadtree::broadInsert(
 
 void Quadtree::broadInsert(const std::vector<EntityHandleIndex>& entities, const std::vector<Vec2>& aabbs)
 {
-	std::vector<uint32_t> ul, ur, dl, dr;
+	FrameVector<uint32_t> ul, ur, dl, dr;
 	ul.reserve(entities.size() / 3);
 	ur.reserve(entities.size() / 3);
 	dl.reserve(entities.size() / 3);
@@ -307,7 +307,7 @@ void Quadtree::querry(std::vector<EntityHandleIndex>& rVec, const Vec2 qryPos, c
 	}
 }
 
-void Quadtree::querry(std::vector<EntityHandleIndex>& rVec, std::vector<QtreeNodeQuerry>& frontier, const Vec2 qryPos, const Vec2 qrySize) const
+void Quadtree::querry(FrameVector<EntityHandleIndex>& rVec, FrameVector<QtreeNodeQuerry>& frontier, const Vec2 qryPos, const Vec2 qrySize) const
 {
 	frontier.clear();
 	if (frontier.capacity() < 20)
@@ -6,6 +6,7 @@
 #include <mutex>
 
 #include "../../engine/types/BaseTypes.hpp"
+#include "../../engine/allocator/FrameAllocator.hpp"
 #include "../../engine/rendering/Sprite.hpp"
 
 #include "../collision/collision_detection.hpp"
@@ -148,7 +149,7 @@ public:
 
 	void broadInsert(const std::vector<EntityHandleIndex>& entities, const std::vector<Vec2>& aabbs);
 
-	void querry(std::vector<EntityHandleIndex>& rVec, std::vector<QtreeNodeQuerry>& buffer, const Vec2 qryPos, const Vec2 qrySize) const;
+	void querry(FrameVector<EntityHandleIndex>& rVec, FrameVector<QtreeNodeQuerry>& buffer, const Vec2 qryPos, const Vec2 qrySize) const;
 
 	void querryDebug(const Vec2 qryPos, const Vec2 qrySize, std::vector<Sprite>& draw) const {
 		querryDebug(qryPos, qrySize, 0, m_pos, m_size, draw, 0);
@@ -190,7 +191,7 @@ public:
 private:
 
 	void insert(const uint32_t ent, const std::vector<Vec2>& aabbs, const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize, const int depth);
-	void broadInsert(std::vector<uint32_t>&& entities, const std::vector<Vec2>& aabbs, const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize, const int depth);
+	void broadInsert(FrameVector<uint32_t>&& entities, const std::vector<Vec2>& aabbs, const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize, const int depth);
 	void querry(std::vector<EntityHandleIndex>& rVec, const Vec2 qryPos, const Vec2 qrySize, const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize) const;
 	void querryDebug(const Vec2 qryPos, const Vec2 qrySize, const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize, std::vector<Sprite>& draw, int depth) const;
 	void querryDebugAll(const uint32_t thisID, const Vec2 thisPos, const Vec2 thisSize, std::vector<Sprite>& draw, const Vec4 color, const int depth) const;
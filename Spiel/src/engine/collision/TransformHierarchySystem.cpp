@@ -0,0 +1,90 @@
+#include "TransformHierarchySystem.hpp"
+
+void TransformHierarchySystem::execute(TransformHierarchySECM secm)
+{
+	sortByDepth(secm);
+
+	for (size_t depth = 1; depth < levelEnds.size(); ++depth) {
+		JobSystem::parallelFor(levelEnds[depth - 1], levelEnds[depth],
+			[&](size_t i, u32 thread) {
+				const Link link = links[i];
+				Transform const& parent = secm.getComp<Transform>(link.parent);
+				LocalTransform const& local = secm.getComp<LocalTransform>(link.entity);
+				Transform& transform = secm.getComp<Transform>(link.entity);
+				transform.position = parent.position + rotate(local.position, parent.rotaVec);
+				transform.rotaVec = parent.rotaVec * local.rotaVec;
+			},
+			0,
+			"transformHierarchy"
+		);
+	}
+}
+
+void TransformHierarchySystem::sortByDepth(TransformHierarchySECM secm)
+{
+	auto& parents = secm.storage<Parent>();
+	EntityHandleIndex const* entities = parents.denseEntities();
+	Parent const* parentComps = parents.denseComponents();
+	depths.assign(secm.maxEntityIndex(), UNKNOWN);
+
+	uint32_t maxDepth{ ROOT };
+	for (size_t i = 0; i < parents.size(); ++i) {
+		const uint32_t depth = depthOf(secm, entities[i]);
+		if (depth != DETACHED) {
+			maxDepth = std::max(maxDepth, depth);
+		}
+	}
+
+	// counting sort by depth, the entities of a level keep the order of the Parent storage:
+	levelEnds.assign(size_t(maxDepth) + 1, 0);
+	for (size_t i = 0; i < parents.size(); ++i) {
+		if (depths[entities[i]] != DETACHED) {
+			++levelEnds[depths[entities[i]]];
+		}
+	}
+	for (size_t depth = 1; depth < levelEnds.size(); ++depth) {
+		levelEnds[depth] += levelEnds[depth - 1];
+	}
+	levelCursors.assign(levelEnds.begin(), levelEnds.end());
+	links.resize(levelEnds.back());
+	for (size_t i = 0; i < parents.size(); ++i) {
+		const EntityHandleIndex entity = entities[i];
+		const uint32_t depth = depths[entity];
+		if (depth != DETACHED) {
+			links[levelCursors[depth - 1]++] = Link{ entity, parentComps[i].entity.index };
+		}
+	}
+}
+
+uint32_t TransformHierarchySystem::depthOf(TransformHierarchySECM& secm, EntityHandleIndex entity)
+{
+	// walk up to the first entity with a known depth, then give all entities on the way their depth:
+	chain.clear();
+	while (depths[entity] == UNKNOWN) {
+		Parent const* parent = secm.getIf<Parent>(entity);
+		if (!parent) {
+			depths[entity] = ROOT;
+			break;
+		}
+		chain.push_back(entity);
+		if (!secm.isHandleValid(parent->entity) || !secm.hasComps<Transform, LocalTransform>(entity) || !secm.hasComp<Transform>(parent->entity.index)) {
+			depths[entity] = DETACHED;
+			break;
+		}
+		depths[entity] = VISITING;
+		entity = parent->entity.index;
+	}
+
+	uint32_t depth = depths[entity];
+	if (depth == VISITING) {
+		// the parents form a cycle:
+		depth = DETACHED;
+	}
+	for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+		if (depth != DETACHED) {
+			++depth;
+		}
+		depths[*iter] = depth;
+	}
+	return depth;
+}
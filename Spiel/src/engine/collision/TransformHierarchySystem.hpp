@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "CollisionUniform.hpp"
+#include "../../engine/math/vector_math.hpp"
+
+#define TRANSFORM_HIERARCHY_SECM_COMPONENTS \
+	Transform,\
+	Parent,\
+	LocalTransform
+
+using TransformHierarchySECM = EntityComponentManagerView<
+	PhysicsArchetype::Column<Transform>,
+	ComponentStoragePagedSet<Parent>,
+	ComponentStoragePagedSet<LocalTransform>
+>;
+
+/**
+ * Computes the Transform of every entity with a Parent and a LocalTransform from the Transform of its parent.
+ *
+ * The entities are sorted by their depth in the hierarchy into one flat array, children of roots have depth 1.
+ * The levels are updated one after another, as all parents of a level are in lower levels, the entities of a level are updated in parallel.
+ * The sorting is done on every execute in one linear pass over the Parent components, the depths are memorized per entity,
+ * so every parent chain is only walked once.
+ *
+ * Entities whose parent handle is invalid, that miss a Transform or a LocalTransform, or that are part of a parent cycle are not updated.
+ * The Transform of a child is overwritten on every execute, so children should not be moved by other systems.
+ */
+class TransformHierarchySystem {
+public:
+	void execute(TransformHierarchySECM secm);
+
+	/**
+	 * \return count of depth levels of the last execute, 0 if no entity was updated.
+	 */
+	size_t depthCount() const { return levelEnds.empty() ? 0 : levelEnds.size() - 1; }
+private:
+	struct Link {
+		EntityHandleIndex entity;
+		EntityHandleIndex parent;
+	};
+
+	void sortByDepth(TransformHierarchySECM secm);
+	uint32_t depthOf(TransformHierarchySECM& secm, EntityHandleIndex entity);
+
+	static constexpr uint32_t ROOT{ 0 };
+	static constexpr uint32_t DETACHED{ 0xFFFFFFFD };
+	static constexpr uint32_t VISITING{ 0xFFFFFFFE };
+	static constexpr uint32_t UNKNOWN{ 0xFFFFFFFF };
+
+	std::vector<uint32_t> depths;			// indexed by entity
+	std::vector<EntityHandleIndex> chain;	// entities with unknown depth found when walking up the parents
+	std::vector<Link> links;				// sorted by depth
+	std::vector<size_t> levelEnds;			// the links of depth d are in [levelEnds[d-1], levelEnds[d])
+	std::vector<size_t> levelCursors;
+};
@@ -7,6 +7,7 @@
 #include "../../engine/math/Vec2.hpp"
 #include "../../engine/entity/EntityTypes.hpp"
 #include "../../engine/rendering/Sprite.hpp"
+#include "../../engine/allocator/FrameAllocator.hpp"
 #include "CollisionUniform.hpp"
 
 struct CollPoint {
@@ -135,12 +136,12 @@ inline void generateCollisionInfos2(
 	CollisionSECM manager,
 	std::vector<CollisionInfo>& collisionInfos,
 	std::vector<Vec2> const& aabbCache,
-	const std::vector<EntityHandleIndex>& nearCollidablesBuffer,
+	const FrameVector<EntityHandleIndex>& nearCollidablesBuffer,
 	const EntityHandleIndex me,
 	const Transform& baseColl,
 	const Collider& colliderColl,
 	const Vec2 aabbMe,
-	std::vector<CollPoint>& collisionVertices)
+	FrameVector<CollPoint>& collisionVertices)
 {
 	const CollidableAdapter collAdapter = CollidableAdapter(
 		baseColl.position,
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <span>
+#include <algorithm>
+#include <tuple>
+#include <cassert>
+
+#include "EntityTypes.hpp"
+
+/**
+ * Records for one component type in which change version each entity's component was last changed.
+ *
+ * The EntityComponentManager stamps the current change version when a component is added or marked as changed.
+ * Every page of PAGE_SIZE entities additionally stores the newest version of its entities,
+ * so queries for changes since a version skip unchanged pages as a whole.
+ * Tracking is optional, a disabled tracker ignores all marks and takes no memory.
+ */
+class ComponentChangeTracker {
+public:
+	static constexpr size_t PAGE_BITS{ 7 };
+	static constexpr size_t PAGE_SIZE{ 1 << PAGE_BITS };
+	static constexpr uint32_t NEVER_CHANGED{ 0 };
+
+	bool isEnabled() const { return bEnabled; }
+
+	/**
+	 * Starts tracking, the entities [0, entityCount) are marked as changed in the given version.
+	 */
+	void enable(size_t entityCount, uint32_t version)
+	{
+		bEnabled = true;
+		versions.assign(entityCount, version);
+		pageVersions.assign((entityCount + PAGE_SIZE - 1) / PAGE_SIZE, version);
+	}
+
+	void disable()
+	{
+		bEnabled = false;
+		versions = {};
+		pageVersions = {};
+	}
+
+	/**
+	 * Marks the component of an entity that was just added as changed, grows the tracker when needed.
+	 * Must not be called concurrently.
+	 */
+	void markInserted(EntityHandleIndex entity, uint32_t version)
+	{
+		if (!bEnabled) return;
+		if (entity >= versions.size()) {
+			versions.resize(size_t(entity) + 1, NEVER_CHANGED);
+			pageVersions.resize((versions.size() + PAGE_SIZE - 1) / PAGE_SIZE, NEVER_CHANGED);
+		}
+		markChanged(entity, version);
+	}
+
+	/**
+	 * Marks the component of an entity as changed.
+	 * Jobs can mark different entities concurrently, so the tracker is not grown here.
+	 * Components added through an EntityComponentManager or one of its views are always in range,
+	 * marks for entities beyond the tracker are ignored.
+	 */
+	void markChanged(EntityHandleIndex entity, uint32_t version)
+	{
+		if (!bEnabled) return;
+		assert(entity < versions.size());	// the component was not added through the EntityComponentManager or a view
+		if (entity >= versions.size()) return;
+		versions[entity] = version;
+		// all concurrent writers store the same version, so the order does not matter:
+		std::atomic_ref<uint32_t>(pageVersions[entity >> PAGE_BITS]).store(version, std::memory_order_relaxed);
+	}
+
+	/**
+	 * \return true if the component of the entity was changed in sinceVersion or later.
+	 */
+	bool changedSince(EntityHandleIndex entity, uint32_t sinceVersion) const
+	{
+		return entity < versions.size() && versions[entity] >= sinceVersion && versions[entity] != NEVER_CHANGED;
+	}
+
+	/**
+	 * \return first entity at or after from that was changed in sinceVersion or later, or end() if there is none.
+	 */
+	EntityHandleIndex nextChanged(EntityHandleIndex from, uint32_t sinceVersion) const
+	{
+		for (size_t entity = from; entity < versions.size(); ) {
+			if (pageVersions[entity >> PAGE_BITS] < sinceVersion) {
+				// no entity of the page changed:
+				entity = ((entity >> PAGE_BITS) + 1) << PAGE_BITS;
+			}
+			else if (changedSince(EntityHandleIndex(entity), sinceVersion)) {
+				return EntityHandleIndex(entity);
+			}
+			else {
+				++entity;
+			}
+		}
+		return end();
+	}
+
+	EntityHandleIndex end() const { return EntityHandleIndex(versions.size()); }
+
+	/**
+	 * Moves the versions to new entity indices, see EntityComponentManager::compact.
+	 * newIndices is indexed by the old entity index, INVALID_ENTITY_HANDLE_INDEX for entities that do not exist.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices)
+	{
+		if (!bEnabled) return;
+		std::vector<uint32_t> newVersions(versions.size(), NEVER_CHANGED);
+		for (size_t entity = 0; entity < versions.size() && entity < newIndices.size(); ++entity) {
+			if (newIndices[entity] != INVALID_ENTITY_HANDLE_INDEX) {
+				newVersions[newIndices[entity]] = versions[entity];
+			}
+		}
+		versions = std::move(newVersions);
+		std::fill(pageVersions.begin(), pageVersions.end(), NEVER_CHANGED);
+		for (size_t entity = 0; entity < versions.size(); ++entity) {
+			pageVersions[entity >> PAGE_BITS] = std::max(pageVersions[entity >> PAGE_BITS], versions[entity]);
+		}
+	}
+
+	size_t memoryConsumtion() const
+	{
+		return versions.capacity() * sizeof(uint32_t) + pageVersions.capacity() * sizeof(uint32_t);
+	}
+
+private:
+	bool bEnabled{ false };
+	std::vector<uint32_t> versions;		// indexed by entity
+	std::vector<uint32_t> pageVersions;	// newest version in every page
+};
+
+/**
+ * Iterates over the spawned entities whose component of type CompType was changed in sinceVersion or later.
+ * Dereferencing the iterator gives a tuple of the entity handle and the component, like an EntityComponentView.
+ * Removed components are not reported.
+ */
+template<typename ECM, typename CompType>
+class ChangedComponentView {
+public:
+	ChangedComponentView(ECM& manager, ComponentChangeTracker const& tracker, uint32_t sinceVersion)
+		: manager{ manager }, tracker{ tracker }, sinceVersion{ sinceVersion }
+	{ }
+
+	class iterator {
+	public:
+		using self_type = iterator;
+		using value_type = std::tuple<EntityHandle, CompType&>;
+		using iterator_category = std::forward_iterator_tag;
+
+		iterator(EntityHandleIndex entity, ChangedComponentView& view)
+			: entity{ entity }, view{ view }
+		{
+			skip();
+		}
+		self_type operator++()
+		{
+			++entity;
+			skip();
+			return *this;
+		}
+		self_type operator++(int junk)
+		{
+			auto oldme = *this;
+			operator++();
+			return oldme;
+		}
+		value_type operator*()
+		{
+			return value_type(view.manager.getHandle(entity), view.manager.template getComp<CompType>(entity));
+		}
+		bool operator==(const self_type& rhs) const
+		{
+			return entity == rhs.entity;
+		}
+		bool operator!=(const self_type& rhs) const
+		{
+			return entity != rhs.entity;
+		}
+	private:
+		void skip()
+		{
+			// the tracker keeps the stamps of removed components, so every hit is checked against the storage:
+			for (entity = view.tracker.nextChanged(entity, view.sinceVersion);
+				entity != view.tracker.end() && !(view.manager.template hasComp<CompType>(entity) && view.manager.isSpawned(entity));
+				entity = view.tracker.nextChanged(entity + 1, view.sinceVersion));
+		}
+
+		EntityHandleIndex entity;
+		ChangedComponentView& view;
+	};
+
+	iterator begin() { return iterator(0, *this); }
+	iterator end() { return iterator(tracker.end(), *this); }
+private:
+	ECM& manager;
+	ComponentChangeTracker const& tracker;
+	uint32_t sinceVersion;
+};
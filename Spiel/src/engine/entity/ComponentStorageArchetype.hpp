@@ -0,0 +1,742 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "EntityComponentStorage.hpp"
+#include "CopyOnWritePages.hpp"
+
+template<typename Group, typename CompType>
+class ComponentStorageArchetypeColumn;
+
+/**
+ * Type erased operations on one component type, used by ComponentStorageArchetype.
+ */
+struct ArchetypeComponentOps {
+	size_t size;
+	size_t alignment;
+	void(*moveConstruct)(void* dst, void* src);
+	void(*copyConstruct)(void* dst, void const* src);
+	void(*destroy)(void* ptr);
+};
+
+template<typename CompType>
+constexpr ArchetypeComponentOps makeArchetypeComponentOps()
+{
+	return ArchetypeComponentOps{
+		sizeof(CompType),
+		alignof(CompType),
+		[](void* dst, void* src) { new (dst) CompType(std::move(*std::launder(reinterpret_cast<CompType*>(src)))); },
+		[](void* dst, void const* src) { new (dst) CompType(*std::launder(reinterpret_cast<CompType const*>(src))); },
+		[](void* ptr) { std::launder(reinterpret_cast<CompType*>(ptr))->~CompType(); }
+	};
+}
+
+/*----------------------------------------------------------------------------------*/
+/*-----------------------------------Archetype--------------------------------------*/
+/*----------------------------------------------------------------------------------*/
+
+/**
+ * Component storage for a group of component types that are often used together.
+ *
+ * Entities are grouped by their signature (the subset of the group's component types they have) into archetypes.
+ * Every archetype stores its entities in fixed size chunks,
+ * inside a chunk every component type has its own packed array (SoA).
+ * So iterating over entities that have several of the group's component types is a linear scan of packed arrays, see forEach.
+ *
+ * The group takes one place in the storage list of an EntityComponentManager, for example:
+ * EntityComponentManager<ComponentStorageArchetype<Transform, Movement>, ComponentStoragePagedSet<Health>>
+ * The storage of a single component type of the group is a Column, it has the same interface as the other component storages.
+ *
+ * Adding or removing a component of the group moves the entity into another archetype,
+ * this moves all of its group components in memory and invalidates references to them.
+ * Removing an entity from an archetype moves the last entity of that archetype into the free row,
+ * so it also invalidates references to the components of that last entity.
+ *
+ * A copy shares the chunks with the original, a chunk is cloned when one of the storages writes to it (see CopyOnWritePages).
+ * So copying costs O(chunk count) plus the entity location table, instead of copying every component.
+ * Reading a component through the const get() never clones a chunk.
+ */
+template<typename ... CompTypes>
+class ComponentStorageArchetype {
+public:
+	static constexpr bool IS_STORAGE_GROUP{ true };
+	static constexpr size_t COMPONENT_COUNT{ sizeof...(CompTypes) };
+	static_assert(COMPONENT_COUNT > 0 && COMPONENT_COUNT <= 32, "an archetype storage holds 1 to 32 component types");
+
+	using Signature = uint32_t;
+	using ComponentTypes = std::tuple<CompTypes...>;
+
+	template<typename CompType>
+	using Column = ComponentStorageArchetypeColumn<ComponentStorageArchetype<CompTypes...>, CompType>;
+
+	template<typename CompType>
+	static constexpr bool holdsComponent()
+	{
+		return (std::is_same_v<CompType, CompTypes> || ...);
+	}
+
+	/**
+	 * \return index of the component type in the group.
+	 */
+	template<typename CompType>
+	static constexpr size_t componentIndex()
+	{
+		static_assert(holdsComponent<CompType>(), "the component type is not part of the archetype storage");
+		constexpr bool matches[] = { std::is_same_v<CompType, CompTypes>... };
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (matches[i]) return i;
+		}
+		return COMPONENT_COUNT;
+	}
+
+	template<typename CompType>
+	static constexpr Signature componentBit()
+	{
+		return Signature(1) << componentIndex<CompType>();
+	}
+
+	ComponentStorageArchetype() :
+		columns{ Column<CompTypes>(this)... }
+	{}
+	ComponentStorageArchetype(ComponentStorageArchetype const& rhs) :
+		ComponentStorageArchetype()
+	{
+		operator=(rhs);
+	}
+	/**
+	 * The callbacks stay with the columns of rhs, like in a copy.
+	 */
+	ComponentStorageArchetype(ComponentStorageArchetype&& rhs) noexcept :
+		ComponentStorageArchetype()
+	{
+		operator=(std::move(rhs));
+	}
+	~ComponentStorageArchetype()
+	{
+		clear();
+	}
+	/**
+	 * The copy shares the chunks with rhs, so rhs must not be accessed concurrently while it is copied.
+	 */
+	ComponentStorageArchetype& operator=(ComponentStorageArchetype const& rhs)
+	{
+		if (this == &rhs) return *this;
+		clear();
+		archetypes = rhs.archetypes;
+		locations = rhs.locations;
+		componentCounts = rhs.componentCounts;
+		return *this;
+	}
+	ComponentStorageArchetype& operator=(ComponentStorageArchetype&& rhs) noexcept
+	{
+		if (this == &rhs) return *this;
+		clear();
+		archetypes = std::move(rhs.archetypes);
+		locations = std::move(rhs.locations);
+		componentCounts = std::exchange(rhs.componentCounts, {});
+		rhs.archetypes.clear();
+		rhs.locations.clear();
+		return *this;
+	}
+
+	/**
+	 * \return storage of one component type of the group.
+	 */
+	template<typename CompType>
+	Column<CompType>& column()
+	{
+		return std::get<componentIndex<CompType>()>(columns);
+	}
+
+	// meta:
+	void updateMaxEntNum(size_t newEntNum)
+	{
+		if (locations.size() < newEntNum) {
+			locations.resize(newEntNum, Location{ NO_ARCHETYPE, 0 });
+		}
+	}
+	size_t memoryConsumtion() const
+	{
+		size_t s = locations.capacity() * sizeof(Location) + archetypes.capacity() * sizeof(Archetype);
+		for (Archetype const& archetype : archetypes) {
+			s += archetype.chunks.size() * sizeof(Chunk);
+		}
+		return s;
+	}
+	/**
+	 * \return memory used by the packed arrays of one component type.
+	 */
+	template<typename CompType>
+	size_t memoryConsumtion() const
+	{
+		size_t s{ 0 };
+		for (Archetype const& archetype : archetypes) {
+			if (archetype.signature & componentBit<CompType>()) {
+				s += archetype.chunks.size() * archetype.chunkCapacity * sizeof(CompType);
+			}
+		}
+		return s;
+	}
+	/**
+	 * \return count of entities that have the component.
+	 */
+	template<typename CompType>
+	size_t size() const
+	{
+		return componentCounts[componentIndex<CompType>()];
+	}
+	/**
+	 * \return count of archetypes that were created so far.
+	 */
+	size_t archetypeCount() const
+	{
+		return archetypes.size();
+	}
+
+	// access:
+	template<typename CompType>
+	void insert(EntityHandleIndex entity, CompType const& comp)
+	{
+		compStoreAssert(!contains<CompType>(entity));
+		updateMaxEntNum(size_t(entity) + 1);
+		constexpr size_t INDEX = componentIndex<CompType>();
+
+		const uint32_t from = locations[entity].archetype;
+		const uint32_t to = from == NO_ARCHETYPE ? findArchetype(componentBit<CompType>()) : addEdge(from, INDEX);
+		const uint32_t row = moveEntity(entity, to);
+		new (archetypes[to].component(INDEX, row)) CompType(comp);
+		componentCounts[INDEX] += 1;
+
+		if (column<CompType>().onInsertCallback) {
+			column<CompType>().onInsertCallback(entity, get<CompType>(entity));
+		}
+	}
+	template<typename CompType>
+	void remove(EntityHandleIndex entity)
+	{
+		compStoreAssert(contains<CompType>(entity));
+		constexpr size_t INDEX = componentIndex<CompType>();
+
+		if (column<CompType>().onRemoveCallback) {
+			column<CompType>().onRemoveCallback(entity, get<CompType>(entity));
+		}
+
+		const Location location = locations[entity];
+		componentCounts[INDEX] -= 1;
+		if ((archetypes[location.archetype].signature & ~componentBit<CompType>()) == 0) {
+			removeRow(location.archetype, location.row);
+			locations[entity].archetype = NO_ARCHETYPE;
+		}
+		else {
+			// the component is not moved into the new archetype, removeRow destroys it:
+			moveEntity(entity, removeEdge(location.archetype, INDEX));
+		}
+	}
+	template<typename CompType>
+	bool contains(EntityHandleIndex entity) const
+	{
+		return containsEntity(entity) && (archetypes[locations[entity].archetype].signature & componentBit<CompType>());
+	}
+	template<typename CompType>
+	CompType& get(EntityHandleIndex entity)
+	{
+		compStoreAssert(contains<CompType>(entity));
+		const Location location = locations[entity];
+		return *std::launder(reinterpret_cast<CompType*>(archetypes[location.archetype].component(componentIndex<CompType>(), location.row)));
+	}
+	template<typename CompType>
+	const CompType& get(EntityHandleIndex entity) const
+	{
+		compStoreAssert(contains<CompType>(entity));
+		const Location location = locations[entity];
+		return *std::launder(reinterpret_cast<CompType const*>(std::as_const(archetypes[location.archetype]).component(componentIndex<CompType>(), location.row)));
+	}
+
+	/**
+	 * \return true if the entity has any component of the group.
+	 */
+	bool containsEntity(EntityHandleIndex entity) const
+	{
+		return entity < locations.size() && locations[entity].archetype != NO_ARCHETYPE;
+	}
+	/**
+	 * Removes all components of the group from the entity at once.
+	 */
+	void removeEntity(EntityHandleIndex entity)
+	{
+		if (!containsEntity(entity)) return;
+		(callRemoveCallback<CompTypes>(entity), ...);
+
+		const Location location = locations[entity];
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (archetypes[location.archetype].signature & (Signature(1) << i)) {
+				componentCounts[i] -= 1;
+			}
+		}
+		removeRow(location.archetype, location.row);
+		locations[entity].archetype = NO_ARCHETYPE;
+	}
+
+	/**
+	 * Moves the components to new entity indices, see EntityComponentManager::compact.
+	 * The rows of the archetypes stay in place, only the entity indices in the chunks are rewritten.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices)
+	{
+		std::vector<Location> newLocations(locations.size(), Location{ NO_ARCHETYPE, 0 });
+		for (Archetype& archetype : archetypes) {
+			for (uint32_t row = 0; row < archetype.size; ++row) {
+				EntityHandleIndex& entity = archetype.entity(row);
+				newLocations[newIndices[entity]] = locations[entity];
+				entity = newIndices[entity];
+			}
+		}
+		locations = std::move(newLocations);
+	}
+
+	/**
+	 * Calls func(EntityHandleIndex, IterCompTypes&...) for every entity that has all the given component types.
+	 * The components are read from the packed arrays of the chunks, one chunk after another.
+	 * func must not add or remove components of the group.
+	 */
+	template<typename ... IterCompTypes, typename Func>
+	void forEach(Func&& func)
+	{
+		constexpr Signature REQUIRED = (componentBit<IterCompTypes>() | ...);
+		for (uint32_t archetype = 0; archetype < archetypes.size(); ++archetype) {
+			if ((archetypes[archetype].signature & REQUIRED) == REQUIRED) {
+				for (uint32_t chunk = 0; chunk < archetypes[archetype].chunks.size(); ++chunk) {
+					forEachInChunk<IterCompTypes...>(ChunkRef{ archetype, chunk }, func);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Identifies one chunk of one archetype, used to split work over chunks.
+	 */
+	struct ChunkRef {
+		uint32_t archetype;
+		uint32_t chunk;
+	};
+
+	/**
+	 * \return all chunks of archetypes that contain all the given component types.
+	 */
+	template<typename ... IterCompTypes>
+	std::vector<ChunkRef> chunks() const
+	{
+		constexpr Signature REQUIRED = (componentBit<IterCompTypes>() | ...);
+		std::vector<ChunkRef> refs;
+		for (uint32_t archetype = 0; archetype < archetypes.size(); ++archetype) {
+			if ((archetypes[archetype].signature & REQUIRED) == REQUIRED) {
+				for (uint32_t chunk = 0; chunk < archetypes[archetype].chunks.size(); ++chunk) {
+					refs.push_back(ChunkRef{ archetype, chunk });
+				}
+			}
+		}
+		return refs;
+	}
+
+	/**
+	 * \return count of entities in the chunk.
+	 */
+	uint32_t chunkSize(ChunkRef ref) const
+	{
+		Archetype const& archetype = archetypes[ref.archetype];
+		return std::min(archetype.chunkCapacity, archetype.size - ref.chunk * archetype.chunkCapacity);
+	}
+
+	/**
+	 * Calls func(EntityHandleIndex, IterCompTypes&...) for every entity in the chunk.
+	 * The chunk's archetype must contain all the given component types.
+	 */
+	template<typename ... IterCompTypes, typename Func>
+	void forEachInChunk(ChunkRef ref, Func&& func)
+	{
+		Archetype& archetype = archetypes[ref.archetype];
+		const uint32_t count = chunkSize(ref);
+		EntityHandleIndex* entities = archetype.chunkEntities(ref.chunk);
+		std::tuple<IterCompTypes*...> componentArrays{ archetype.template chunkColumn<IterCompTypes>(ref.chunk)... };
+		for (uint32_t i = 0; i < count; ++i) {
+			func(entities[i], std::get<IterCompTypes*>(componentArrays)[i]...);
+		}
+	}
+
+private:
+	template<typename Group, typename CompType>
+	friend class ComponentStorageArchetypeColumn;
+
+	static constexpr uint32_t NO_ARCHETYPE{ 0xFFFFFFFF };
+	static constexpr size_t CHUNK_SIZE{ 1 << 14 };
+	static constexpr size_t CHUNK_ALIGNMENT{ 64 };
+	static_assert(((alignof(CompTypes) <= CHUNK_ALIGNMENT) && ...), "component alignment is too big for archetype chunks");
+	static_assert(((sizeof(CompTypes) * 16 <= CHUNK_SIZE) && ...), "components are too big for archetype chunks");
+
+	inline static constexpr std::array<ArchetypeComponentOps, COMPONENT_COUNT> componentOps{ makeArchetypeComponentOps<CompTypes>()... };	// indexed like CompTypes
+
+	/**
+	 * Rows of one archetype, the chunk owns the components of its first count rows.
+	 * Cloning a chunk copies these components and destroying it destroys them,
+	 * so a chunk that is shared between copies of the storage lives as long as one of them holds it.
+	 */
+	struct Chunk {
+		Chunk() = default;
+		Chunk(Chunk const& rhs) :
+			signature{ rhs.signature },
+			count{ rhs.count },
+			columnOffsets{ rhs.columnOffsets }
+		{
+			std::memcpy(memory, rhs.memory, sizeof(EntityHandleIndex) * count);
+			for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+				if (signature & (Signature(1) << i)) {
+					for (uint32_t row = 0; row < count; ++row) {
+						componentOps[i].copyConstruct(component(i, row), rhs.component(i, row));
+					}
+				}
+			}
+		}
+		Chunk& operator=(Chunk const&) = delete;
+		~Chunk()
+		{
+			for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+				if (signature & (Signature(1) << i)) {
+					for (uint32_t row = 0; row < count; ++row) {
+						componentOps[i].destroy(component(i, row));
+					}
+				}
+			}
+		}
+
+		std::byte* component(size_t compIndex, uint32_t row)
+		{
+			return memory + columnOffsets[compIndex] + size_t(row) * componentOps[compIndex].size;
+		}
+		std::byte const* component(size_t compIndex, uint32_t row) const
+		{
+			return memory + columnOffsets[compIndex] + size_t(row) * componentOps[compIndex].size;
+		}
+
+		Signature signature{ 0 };
+		uint32_t count{ 0 };									// rows with constructed components
+		std::array<uint32_t, COMPONENT_COUNT> columnOffsets{};	// copied from the archetype
+		alignas(CHUNK_ALIGNMENT) std::byte memory[CHUNK_SIZE];
+	};
+
+	/**
+	 * All entities with the same signature.
+	 * Row r is stored in chunk r / chunkCapacity, at index r % chunkCapacity.
+	 * Every chunk starts with the array of entity indices, followed by one array per component type of the signature.
+	 * The non const accessors clone a shared chunk, the const ones only read it.
+	 */
+	struct Archetype {
+		Signature signature;
+		uint32_t chunkCapacity;
+		uint32_t size;
+		std::array<uint32_t, COMPONENT_COUNT> columnOffsets;	// byte offset of the array of every component type in a chunk
+		std::array<uint32_t, COMPONENT_COUNT> addEdges;		// archetype an entity moves to when a component is added, NO_ARCHETYPE until it is used the first time
+		std::array<uint32_t, COMPONENT_COUNT> removeEdges;	// archetype an entity moves to when a component is removed, NO_ARCHETYPE until it is used the first time
+		CopyOnWritePages<Chunk> chunks;
+
+		EntityHandleIndex* chunkEntities(size_t chunk)
+		{
+			return reinterpret_cast<EntityHandleIndex*>(chunks.page(chunk)->memory);
+		}
+		EntityHandleIndex const* chunkEntities(size_t chunk) const
+		{
+			return reinterpret_cast<EntityHandleIndex const*>(chunks.page(chunk)->memory);
+		}
+		template<typename CompType>
+		CompType* chunkColumn(size_t chunk)
+		{
+			return std::launder(reinterpret_cast<CompType*>(chunks.page(chunk)->memory + columnOffsets[componentIndex<CompType>()]));
+		}
+		EntityHandleIndex& entity(uint32_t row)
+		{
+			return chunkEntities(row / chunkCapacity)[row % chunkCapacity];
+		}
+		EntityHandleIndex const& entity(uint32_t row) const
+		{
+			return chunkEntities(row / chunkCapacity)[row % chunkCapacity];
+		}
+		std::byte* component(size_t compIndex, uint32_t row)
+		{
+			return chunks.page(row / chunkCapacity)->component(compIndex, row % chunkCapacity);
+		}
+		std::byte const* component(size_t compIndex, uint32_t row) const
+		{
+			return chunks.page(row / chunkCapacity)->component(compIndex, row % chunkCapacity);
+		}
+	};
+
+	struct Location {
+		uint32_t archetype;		// NO_ARCHETYPE when the entity has no component of the group
+		uint32_t row;
+	};
+
+	/**
+	 * \return index of the archetype with the signature, creates it when it does not exist yet.
+	 */
+	uint32_t findArchetype(Signature signature)
+	{
+		for (uint32_t i = 0; i < archetypes.size(); ++i) {
+			if (archetypes[i].signature == signature) return i;
+		}
+
+		Archetype archetype;
+		archetype.signature = signature;
+		archetype.size = 0;
+		archetype.columnOffsets.fill(0);
+		archetype.addEdges.fill(NO_ARCHETYPE);
+		archetype.removeEdges.fill(NO_ARCHETYPE);
+
+		size_t rowBytes = sizeof(EntityHandleIndex);
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (signature & (Signature(1) << i)) rowBytes += componentOps[i].size;
+		}
+		// the alignment of the arrays can waste some bytes, so the capacity is reduced until the layout fits:
+		uint32_t capacity = uint32_t(CHUNK_SIZE / rowBytes);
+		while (!layoutChunk(archetype, capacity)) {
+			--capacity;
+		}
+		archetype.chunkCapacity = capacity;
+
+		archetypes.push_back(std::move(archetype));
+		return uint32_t(archetypes.size() - 1);
+	}
+
+	static bool layoutChunk(Archetype& archetype, uint32_t capacity)
+	{
+		size_t offset = sizeof(EntityHandleIndex) * capacity;
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (archetype.signature & (Signature(1) << i)) {
+				offset = (offset + componentOps[i].alignment - 1) / componentOps[i].alignment * componentOps[i].alignment;
+				archetype.columnOffsets[i] = uint32_t(offset);
+				offset += componentOps[i].size * capacity;
+			}
+		}
+		return offset <= CHUNK_SIZE;
+	}
+
+	uint32_t addEdge(uint32_t from, size_t compIndex)
+	{
+		if (archetypes[from].addEdges[compIndex] == NO_ARCHETYPE) {
+			const uint32_t to = findArchetype(archetypes[from].signature | (Signature(1) << compIndex));
+			archetypes[from].addEdges[compIndex] = to;
+		}
+		return archetypes[from].addEdges[compIndex];
+	}
+
+	uint32_t removeEdge(uint32_t from, size_t compIndex)
+	{
+		if (archetypes[from].removeEdges[compIndex] == NO_ARCHETYPE) {
+			const uint32_t to = findArchetype(archetypes[from].signature & ~(Signature(1) << compIndex));
+			archetypes[from].removeEdges[compIndex] = to;
+		}
+		return archetypes[from].removeEdges[compIndex];
+	}
+
+	uint32_t appendRow(uint32_t archetypeIndex, EntityHandleIndex entity)
+	{
+		Archetype& archetype = archetypes[archetypeIndex];
+		if (archetype.size == archetype.chunks.size() * archetype.chunkCapacity) {
+			const size_t chunkIndex = archetype.chunks.size();
+			archetype.chunks.resize(chunkIndex + 1);
+			Chunk& chunk = archetype.chunks.emplace(chunkIndex);
+			chunk.signature = archetype.signature;
+			chunk.columnOffsets = archetype.columnOffsets;
+		}
+		const uint32_t row = archetype.size++;
+		archetype.chunks.page(row / archetype.chunkCapacity)->count += 1;
+		archetype.entity(row) = entity;
+		return row;
+	}
+
+	/**
+	 * Destroys the components in the row and moves the last row of the archetype into it.
+	 */
+	void removeRow(uint32_t archetypeIndex, uint32_t row)
+	{
+		Archetype& archetype = archetypes[archetypeIndex];
+		const uint32_t last = archetype.size - 1;
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (archetype.signature & (Signature(1) << i)) {
+				componentOps[i].destroy(archetype.component(i, row));
+				if (row != last) {
+					componentOps[i].moveConstruct(archetype.component(i, row), archetype.component(i, last));
+					componentOps[i].destroy(archetype.component(i, last));
+				}
+			}
+		}
+		if (row != last) {
+			const EntityHandleIndex moved = archetype.entity(last);
+			archetype.entity(row) = moved;
+			locations[moved].row = row;
+		}
+		archetype.size -= 1;
+		archetype.chunks.page(last / archetype.chunkCapacity)->count -= 1;
+		if (archetype.size <= (archetype.chunks.size() - 1) * archetype.chunkCapacity) {
+			archetype.chunks.resize(archetype.chunks.size() - 1);
+		}
+	}
+
+	/**
+	 * Moves the entity into another archetype.
+	 * The components that both archetypes contain are moved, components that only the new archetype contains are left uninitialized.
+	 *
+	 * \return row of the entity in the new archetype.
+	 */
+	uint32_t moveEntity(EntityHandleIndex entity, uint32_t to)
+	{
+		const Location from = locations[entity];
+		const uint32_t row = appendRow(to, entity);
+		if (from.archetype != NO_ARCHETYPE) {
+			Archetype& fromArchetype = archetypes[from.archetype];
+			Archetype& toArchetype = archetypes[to];
+			for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+				if (fromArchetype.signature & toArchetype.signature & (Signature(1) << i)) {
+					componentOps[i].moveConstruct(toArchetype.component(i, row), fromArchetype.component(i, from.row));
+				}
+			}
+			removeRow(from.archetype, from.row);
+		}
+		locations[entity] = Location{ to, row };
+		return row;
+	}
+
+	template<typename CompType>
+	void callRemoveCallback(EntityHandleIndex entity)
+	{
+		if (column<CompType>().onRemoveCallback && contains<CompType>(entity)) {
+			column<CompType>().onRemoveCallback(entity, get<CompType>(entity));
+		}
+	}
+
+	/**
+	 * Removes all entities, calls the remove callbacks for every component.
+	 * The chunks destroy their components, chunks that a copy still holds stay alive for it.
+	 */
+	void clear()
+	{
+		for (EntityHandleIndex entity = 0; entity < locations.size(); ++entity) {
+			if (containsEntity(entity)) {
+				(callRemoveCallback<CompTypes>(entity), ...);
+			}
+		}
+		archetypes.clear();
+		locations.clear();
+		componentCounts.fill(0);
+	}
+
+	std::vector<Archetype> archetypes;
+	std::vector<Location> locations;						// indexed by entity
+	std::array<size_t, COMPONENT_COUNT> componentCounts{};	// count of entities that have a component, indexed like CompTypes
+	std::tuple<Column<CompTypes>...> columns;
+};
+
+/**
+ * Storage of one component type of a ComponentStorageArchetype.
+ * Implements the interface of the other component storages on top of the archetype storage.
+ */
+template<typename Group, typename CompType>
+class ComponentStorageArchetypeColumn : public ComponentStorageBase<CompType> {
+public:
+	explicit ComponentStorageArchetypeColumn(Group* group) :
+		archetypeStorage{ group }
+	{}
+
+	/**
+	 * \return the archetype storage the column belongs to.
+	 */
+	Group& group() { return *archetypeStorage; }
+
+	// meta:
+	void updateMaxEntNum(size_t newEntNum) { archetypeStorage->updateMaxEntNum(newEntNum); }
+	size_t memoryConsumtion() { return archetypeStorage->template memoryConsumtion<CompType>(); }
+	size_t size() const { return archetypeStorage->template size<CompType>(); }
+
+	// access:
+	void insert(EntityHandleIndex entity, CompType const& comp) { archetypeStorage->template insert<CompType>(entity, comp); }
+	void remove(EntityHandleIndex entity) { archetypeStorage->template remove<CompType>(entity); }
+	bool contains(EntityHandleIndex entity) const { return archetypeStorage->template contains<CompType>(entity); }
+	CompType& get(EntityHandleIndex entity) { return archetypeStorage->template get<CompType>(entity); }
+	const CompType& get(EntityHandleIndex entity) const { return archetypeStorage->template get<CompType>(entity); }
+
+	/**
+	 * Iterates over the entities of all archetypes that contain the component type, archetype by archetype.
+	 */
+	class iterator {
+	public:
+		using self_type = iterator;
+		using value_type = EntityHandleIndex;
+		using reference = EntityHandleIndex const&;
+		using pointer = EntityHandleIndex const*;
+		using iterator_category = std::forward_iterator_tag;
+
+		iterator(uint32_t archetype, uint32_t row, Group& group)
+			: archetype{ archetype }, row{ row }, group{ group }
+		{
+			skipEmpty();
+		}
+		self_type operator++()
+		{
+			++row;
+			skipEmpty();
+			return *this;
+		}
+		self_type operator++(int dummy)
+		{
+			self_type me = *this;
+			operator++();
+			return me;
+		}
+		reference operator*()
+		{
+			return std::as_const(group.archetypes[archetype]).entity(row);
+		}
+		pointer operator->()
+		{
+			return &std::as_const(group.archetypes[archetype]).entity(row);
+		}
+		bool operator==(self_type const& rhs) const
+		{
+			return archetype == rhs.archetype && row == rhs.row;
+		}
+		bool operator!=(self_type const& rhs) const
+		{
+			return !operator==(rhs);
+		}
+		CompType& data()
+		{
+			return *std::launder(reinterpret_cast<CompType*>(group.archetypes[archetype].component(Group::template componentIndex<CompType>(), row)));
+		}
+	private:
+		void skipEmpty()
+		{
+			while (archetype < group.archetypes.size() &&
+				(!(group.archetypes[archetype].signature & Group::template componentBit<CompType>()) || row >= group.archetypes[archetype].size)) {
+				++archetype;
+				row = 0;
+			}
+		}
+
+		uint32_t archetype;
+		uint32_t row;
+		Group& group;
+	};
+	iterator begin() { return iterator(0, 0, *archetypeStorage); }
+	iterator end() { return iterator(uint32_t(archetypeStorage->archetypes.size()), 0, *archetypeStorage); }
+private:
+	friend Group;
+
+	Group* archetypeStorage;
+};
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+#include "EntityComponentStorage.hpp"
+
+template<typename Group, typename CompType>
+class ComponentStorageOwningGroupColumn;
+
+/*----------------------------------------------------------------------------------*/
+/*----------------------------------Owning-Group------------------------------------*/
+/*----------------------------------------------------------------------------------*/
+
+/**
+ * Component storage for a group of component types that are mostly iterated together.
+ *
+ * Every component type is stored in its own paged set.
+ * The group keeps the entities that have all component types of the group at the front of every dense array, in the same order.
+ * So the first groupSize() entries of all dense arrays belong to the same entities
+ * and iterating over them is a zipped linear loop without sparse lookups, see forEach.
+ * Entities that only have some of the group's component types are stored behind the group.
+ *
+ * The group takes one place in the storage list of an EntityComponentManager, for example:
+ * EntityComponentManager<ComponentStorageOwningGroup<Transform, Movement>, ComponentStoragePagedSet<Health>>
+ * The storage of a single component type of the group is a Column, it has the same interface as the other component storages.
+ *
+ * An entity enters the group when it gets the last missing component and leaves it when it loses one.
+ * Both swap one entry per dense array, so adding and removing stays O(1),
+ * but it invalidates references to the components of the swapped entities.
+ */
+template<typename ... CompTypes>
+class ComponentStorageOwningGroup {
+public:
+	static constexpr bool IS_STORAGE_GROUP{ true };
+	static constexpr size_t COMPONENT_COUNT{ sizeof...(CompTypes) };
+	static_assert(COMPONENT_COUNT > 1, "an owning group holds at least 2 component types");
+
+	using ComponentTypes = std::tuple<CompTypes...>;
+
+	template<typename CompType>
+	using Column = ComponentStorageOwningGroupColumn<ComponentStorageOwningGroup<CompTypes...>, CompType>;
+
+	template<typename CompType>
+	static constexpr bool holdsComponent()
+	{
+		return (std::is_same_v<CompType, CompTypes> || ...);
+	}
+
+	/**
+	 * \return true if the component types contain every component type of the group.
+	 * Only then the entities of a query are exactly the entities of the group.
+	 */
+	template<typename ... QueryCompTypes>
+	static constexpr bool coveredBy()
+	{
+		return (containsType<CompTypes, QueryCompTypes...>() && ...);
+	}
+
+	/**
+	 * \return index of the component type in the group.
+	 */
+	template<typename CompType>
+	static constexpr size_t componentIndex()
+	{
+		static_assert(holdsComponent<CompType>(), "the component type is not part of the owning group");
+		constexpr bool matches[] = { std::is_same_v<CompType, CompTypes>... };
+		for (size_t i = 0; i < COMPONENT_COUNT; ++i) {
+			if (matches[i]) return i;
+		}
+		return COMPONENT_COUNT;
+	}
+
+	ComponentStorageOwningGroup() :
+		columns{ Column<CompTypes>(this)... }
+	{}
+	ComponentStorageOwningGroup(ComponentStorageOwningGroup const& rhs) :
+		ComponentStorageOwningGroup()
+	{
+		operator=(rhs);
+	}
+	ComponentStorageOwningGroup(ComponentStorageOwningGroup&& rhs) noexcept :
+		ComponentStorageOwningGroup()
+	{
+		operator=(std::move(rhs));
+	}
+	~ComponentStorageOwningGroup()
+	{
+		(callRemoveCallbackOnEverything<CompTypes>(), ...);
+	}
+	ComponentStorageOwningGroup& operator=(ComponentStorageOwningGroup const& rhs)
+	{
+		if (this == &rhs) return *this;
+		(callRemoveCallbackOnEverything<CompTypes>(), ...);
+		storages = rhs.storages;
+		ownedCount = rhs.ownedCount;
+		return *this;
+	}
+	ComponentStorageOwningGroup& operator=(ComponentStorageOwningGroup&& rhs) noexcept
+	{
+		if (this == &rhs) return *this;
+		(callRemoveCallbackOnEverything<CompTypes>(), ...);
+		storages = std::move(rhs.storages);
+		ownedCount = std::exchange(rhs.ownedCount, 0);
+		return *this;
+	}
+
+	/**
+	 * \return storage of one component type of the group.
+	 */
+	template<typename CompType>
+	Column<CompType>& column()
+	{
+		return std::get<componentIndex<CompType>()>(columns);
+	}
+
+	// meta:
+	void updateMaxEntNum(size_t newEntNum)
+	{
+		(storage<CompTypes>().updateMaxEntNum(EntityHandleIndex(newEntNum)), ...);
+	}
+	size_t memoryConsumtion()
+	{
+		return (storage<CompTypes>().memoryConsumtion() + ...);
+	}
+	template<typename CompType>
+	size_t memoryConsumtion()
+	{
+		return storage<CompType>().memoryConsumtion();
+	}
+	template<typename CompType>
+	size_t size() const
+	{
+		return storage<CompType>().size();
+	}
+	/**
+	 * \return count of entities that have all component types of the group.
+	 */
+	size_t groupSize() const
+	{
+		return ownedCount;
+	}
+
+	// access:
+	template<typename CompType>
+	void insert(EntityHandleIndex entity, CompType const& comp)
+	{
+		storage<CompType>().insert(entity, comp);
+		if ((storage<CompTypes>().contains(entity) && ...)) {
+			(storage<CompTypes>().swapDense(storage<CompTypes>().denseIndex(entity), ownedCount), ...);
+			ownedCount += 1;
+		}
+
+		if (column<CompType>().onInsertCallback) {
+			column<CompType>().onInsertCallback(entity, get<CompType>(entity));
+		}
+	}
+	template<typename CompType>
+	void remove(EntityHandleIndex entity)
+	{
+		compStoreAssert(contains<CompType>(entity));
+		if (column<CompType>().onRemoveCallback) {
+			column<CompType>().onRemoveCallback(entity, get<CompType>(entity));
+		}
+
+		leaveGroup(entity);
+		storage<CompType>().remove(entity);
+	}
+	template<typename CompType>
+	bool contains(EntityHandleIndex entity) const
+	{
+		return storage<CompType>().contains(entity);
+	}
+	template<typename CompType>
+	CompType& get(EntityHandleIndex entity)
+	{
+		return storage<CompType>().get(entity);
+	}
+	template<typename CompType>
+	const CompType& get(EntityHandleIndex entity) const
+	{
+		return storage<CompType>().get(entity);
+	}
+
+	/**
+	 * Removes all components of the group from the entity at once.
+	 */
+	void removeEntity(EntityHandleIndex entity)
+	{
+		(callRemoveCallback<CompTypes>(entity), ...);
+		leaveGroup(entity);
+		(removeIfContained<CompTypes>(entity), ...);
+	}
+
+	/**
+	 * Moves the components to new entity indices, see EntityComponentManager::compact.
+	 * The entities inside and behind the group are sorted by entity index.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices)
+	{
+		(storage<CompTypes>().remapEntities(newIndices, false), ...);
+		// all dense arrays hold the same entities in the group range, so sorting them separately keeps them aligned:
+		(storage<CompTypes>().sortDenseRange(0, ownedCount), ...);
+		(storage<CompTypes>().sortDenseRange(ownedCount, storage<CompTypes>().size()), ...);
+	}
+
+	/**
+	 * Calls func(EntityHandleIndex, IterCompTypes&...) for every entity that has all component types of the group.
+	 * IterCompTypes can be any subset of the group's component types, all of them by default.
+	 * func must not add or remove components of the group.
+	 */
+	template<typename ... IterCompTypes, typename Func>
+	void forEach(Func&& func)
+	{
+		forEachInGroupRange<IterCompTypes...>(0, ownedCount, func);
+	}
+
+	/**
+	 * Calls func(EntityHandleIndex, IterCompTypes&...) for the entries [begin, end) of the group, used to split work over threads.
+	 * end must not be bigger than groupSize().
+	 */
+	template<typename ... IterCompTypes, typename Func>
+	void forEachInGroupRange(size_t begin, size_t end, Func&& func)
+	{
+		compStoreAssert(begin <= end && end <= ownedCount);
+		if constexpr (sizeof...(IterCompTypes) == 0) {
+			forEachInGroupRange<CompTypes...>(begin, end, func);
+		}
+		else {
+			EntityHandleIndex const* entities = std::get<0>(storages).denseEntities();
+			std::tuple<IterCompTypes*...> componentArrays{ storage<IterCompTypes>().denseComponents()... };
+			for (size_t i = begin; i < end; ++i) {
+				func(entities[i], std::get<IterCompTypes*>(componentArrays)[i]...);
+			}
+		}
+	}
+
+private:
+	template<typename Group, typename CompType>
+	friend class ComponentStorageOwningGroupColumn;
+
+	template<typename T, typename ... Ts>
+	static constexpr bool containsType()
+	{
+		return (std::is_same_v<T, Ts> || ...);
+	}
+
+	template<typename CompType>
+	ComponentStoragePagedSet<CompType>& storage()
+	{
+		return std::get<componentIndex<CompType>()>(storages);
+	}
+	template<typename CompType>
+	ComponentStoragePagedSet<CompType> const& storage() const
+	{
+		return std::get<componentIndex<CompType>()>(storages);
+	}
+
+	/**
+	 * Moves the entity behind the group, when it is part of it.
+	 * The last entity of the group takes its place.
+	 */
+	void leaveGroup(EntityHandleIndex entity)
+	{
+		auto& first = std::get<0>(storages);
+		if (first.contains(entity) && first.denseIndex(entity) < ownedCount) {
+			ownedCount -= 1;
+			(storage<CompTypes>().swapDense(storage<CompTypes>().denseIndex(entity), ownedCount), ...);
+		}
+	}
+
+	template<typename CompType>
+	void removeIfContained(EntityHandleIndex entity)
+	{
+		if (storage<CompType>().contains(entity)) {
+			storage<CompType>().remove(entity);
+		}
+	}
+
+	template<typename CompType>
+	void callRemoveCallback(EntityHandleIndex entity)
+	{
+		if (column<CompType>().onRemoveCallback && contains<CompType>(entity)) {
+			column<CompType>().onRemoveCallback(entity, get<CompType>(entity));
+		}
+	}
+
+	template<typename CompType>
+	void callRemoveCallbackOnEverything()
+	{
+		if (column<CompType>().onRemoveCallback) {
+			for (auto iter = storage<CompType>().begin(); iter != storage<CompType>().end(); ++iter) {
+				column<CompType>().onRemoveCallback(*iter, iter.data());
+			}
+		}
+	}
+
+	std::tuple<ComponentStoragePagedSet<CompTypes>...> storages;	// the inner storages have no callbacks, the columns call them
+	size_t ownedCount{ 0 };											// the first ownedCount entries of every dense array belong to the group
+	std::tuple<Column<CompTypes>...> columns;
+};
+
+/**
+ * Storage of one component type of a ComponentStorageOwningGroup.
+ * Implements the interface of the other component storages on top of the group.
+ */
+template<typename Group, typename CompType>
+class ComponentStorageOwningGroupColumn : public ComponentStorageBase<CompType> {
+public:
+	explicit ComponentStorageOwningGroupColumn(Group* group) :
+		owningGroup{ group }
+	{}
+
+	/**
+	 * \return the owning group the column belongs to.
+	 */
+	Group& group() { return *owningGroup; }
+
+	// meta:
+	void updateMaxEntNum(size_t newEntNum) { owningGroup->updateMaxEntNum(newEntNum); }
+	size_t memoryConsumtion() { return owningGroup->template memoryConsumtion<CompType>(); }
+	size_t size() const { return owningGroup->template size<CompType>(); }
+
+	// access:
+	void insert(EntityHandleIndex entity, CompType const& comp) { owningGroup->template insert<CompType>(entity, comp); }
+	void remove(EntityHandleIndex entity) { owningGroup->template remove<CompType>(entity); }
+	bool contains(EntityHandleIndex entity) const { return owningGroup->template contains<CompType>(entity); }
+	CompType& get(EntityHandleIndex entity) { return owningGroup->template get<CompType>(entity); }
+	const CompType& get(EntityHandleIndex entity) const { return owningGroup->template get<CompType>(entity); }
+
+	/**
+	 * Iterates over the dense array of the component type, the entities of the group come first.
+	 */
+	auto begin() { return owningGroup->template storage<CompType>().begin(); }
+	auto end() { return owningGroup->template storage<CompType>().end(); }
+
+	/**
+	 * Calls func(EntityHandleIndex, CompType&) for the entries [begin, end) of the dense array.
+	 */
+	template<typename Func>
+	void forEachInDenseRange(size_t begin, size_t end, Func&& func)
+	{
+		owningGroup->template storage<CompType>().forEachInDenseRange(begin, end, func);
+	}
+private:
+	friend Group;
+
+	Group* owningGroup;
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+/**
+ * Array of optional pages that copies of the array share until one of them writes to a page.
+ *
+ * Copying the array only copies the page pointers and marks all pages as shared in both arrays,
+ * so taking a snapshot of a component storage costs O(page count) instead of copying all components.
+ * The first access to a shared page through the non const page() clones it if the other array still holds it,
+ * it hands out mutable pages, so every access through it counts as a write. The const page() only reads and never clones.
+ *
+ * page() may be called concurrently for the same and different pages, for example by jobs in a parallelEach.
+ * Cloning is synchronized with a mutex that is only taken for pages that are marked as shared.
+ * The const page() never locks, it loads a raw pointer to the page that is published atomically when the page is cloned.
+ * A page replaced by its clone is kept alive until the next resize, emplace, reset or copy,
+ * so pointers that concurrent readers got from the const page() stay valid meanwhile.
+ * All other functions, including copying, must not be called concurrently with page() on the same array.
+ */
+template<typename Page>
+class CopyOnWritePages {
+public:
+	CopyOnWritePages() = default;
+	CopyOnWritePages(CopyOnWritePages const& rhs)
+	{
+		operator=(rhs);
+	}
+	CopyOnWritePages(CopyOnWritePages&& rhs) noexcept :
+		pages{ std::move(rhs.pages) },
+		pagePtrs{ std::move(rhs.pagePtrs) },
+		sharedFlags{ std::move(rhs.sharedFlags) },
+		retired{ std::move(rhs.retired) }
+	{}
+	/**
+	 * Shares all pages with rhs, rhs marks its pages as shared too.
+	 */
+	CopyOnWritePages& operator=(CopyOnWritePages const& rhs)
+	{
+		if (this == &rhs) return *this;
+		pages = rhs.pages;
+		pagePtrs = rhs.pagePtrs;
+		sharedFlags.assign(pages.size(), 1);
+		retired.clear();
+		std::fill(rhs.sharedFlags.begin(), rhs.sharedFlags.end(), uint8_t(1));
+		return *this;
+	}
+	CopyOnWritePages& operator=(CopyOnWritePages&& rhs) noexcept
+	{
+		pages = std::move(rhs.pages);
+		pagePtrs = std::move(rhs.pagePtrs);
+		sharedFlags = std::move(rhs.sharedFlags);
+		retired = std::move(rhs.retired);
+		return *this;
+	}
+
+	size_t size() const { return pages.size(); }
+
+	void resize(size_t count)
+	{
+		pages.resize(count);
+		pagePtrs.resize(count, nullptr);
+		sharedFlags.resize(count, 0);
+		retired.clear();
+	}
+
+	/**
+	 * \return the page, nullptr if there is none. A shared page is cloned first.
+	 */
+	Page* page(size_t index)
+	{
+		unshare(index);
+		return pagePtrs[index];
+	}
+	/**
+	 * \return the page without cloning it, nullptr if there is none.
+	 */
+	Page const* page(size_t index) const
+	{
+		return std::atomic_ref<Page*>(pagePtrs[index]).load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Reads a page without cloning it, for example to plan work on the main thread while jobs access the array.
+	 * \return the page, that stays alive as long as the returned pointer, nullptr if there is none.
+	 */
+	std::shared_ptr<Page const> peek(size_t index) const
+	{
+		if (std::atomic_ref<uint8_t>(sharedFlags[index]).load(std::memory_order_acquire)) {
+			std::lock_guard lock(mutex);
+			// the copy dropped or cloned the page, later accesses skip the lock:
+			if (!pages[index] || pages[index].use_count() == 1) {
+				std::atomic_ref<uint8_t>(sharedFlags[index]).store(0, std::memory_order_release);
+			}
+			return pages[index];
+		}
+		return pages[index];
+	}
+
+	/**
+	 * Replaces the page with a default constructed one.
+	 */
+	Page& emplace(size_t index)
+	{
+		pages[index] = std::make_shared<Page>();
+		pagePtrs[index] = pages[index].get();
+		sharedFlags[index] = 0;
+		retired.clear();
+		return *pages[index];
+	}
+
+	void reset(size_t index)
+	{
+		pages[index].reset();
+		pagePtrs[index] = nullptr;
+		sharedFlags[index] = 0;
+		retired.clear();
+	}
+
+	/**
+	 * \return count of pages that are still marked as shared with a copy.
+	 */
+	size_t sharedPageCount() const
+	{
+		return size_t(std::count(sharedFlags.begin(), sharedFlags.end(), uint8_t(1)));
+	}
+
+private:
+	void unshare(size_t index)
+	{
+		if (!std::atomic_ref<uint8_t>(sharedFlags[index]).load(std::memory_order_acquire)) return;
+
+		std::lock_guard lock(mutex);
+		if (sharedFlags[index]) {
+			// the copy may have dropped or cloned the page already, then it is no longer shared:
+			if (pages[index] && pages[index].use_count() > 1) {
+				retired.push_back(pages[index]);
+				pages[index] = std::make_shared<Page>(*pages[index]);
+				std::atomic_ref<Page*>(pagePtrs[index]).store(pages[index].get(), std::memory_order_release);
+			}
+			std::atomic_ref<uint8_t>(sharedFlags[index]).store(0, std::memory_order_release);
+		}
+	}
+
+	std::vector<std::shared_ptr<Page>> pages;
+	mutable std::vector<Page*> pagePtrs;		// pages[i].get(), read by the const page() without locking
+	mutable std::vector<uint8_t> sharedFlags;	// 1 if the page may be shared with a copy, indexed like pages
+	std::vector<std::shared_ptr<Page>> retired;	// pages replaced by their clone, concurrent readers may still hold them
+	mutable std::mutex mutex;					// taken to clone shared pages and by peek() while they may be cloned
+};
+
+/**
+ * Value that copies share until one of them writes to it, the single page version of CopyOnWritePages.
+ * The non const get() clones a shared value, the const get() only reads and never clones.
+ * get() may be called concurrently, the other functions must not be called concurrently with get() on the same object.
+ * The const get() never locks, it loads a raw pointer to the value that is published atomically when the value is cloned.
+ * A value replaced by its clone is kept alive until the next copy, so references that concurrent readers got stay valid.
+ * The value is created by the first non const get(), until then the const get() returns a default constructed T,
+ * so constructing and moving never allocate and a moved from object is empty.
+ */
+template<typename T>
+class CopyOnWrite {
+public:
+	CopyOnWrite() = default;
+	CopyOnWrite(CopyOnWrite const& rhs)
+	{
+		operator=(rhs);
+	}
+	CopyOnWrite(CopyOnWrite&& rhs) noexcept
+	{
+		operator=(std::move(rhs));
+	}
+	/**
+	 * Shares the value with rhs, rhs marks its value as shared too.
+	 */
+	CopyOnWrite& operator=(CopyOnWrite const& rhs)
+	{
+		if (this == &rhs) return *this;
+		value = rhs.value;
+		valuePtr = rhs.valuePtr;
+		retired.reset();
+		bShared = 1;
+		rhs.bShared = 1;
+		return *this;
+	}
+	CopyOnWrite& operator=(CopyOnWrite&& rhs) noexcept
+	{
+		if (this == &rhs) return *this;
+		value = std::move(rhs.value);
+		valuePtr = std::exchange(rhs.valuePtr, nullptr);
+		bShared = std::exchange(rhs.bShared, uint8_t(0));
+		retired = std::move(rhs.retired);
+		return *this;
+	}
+
+	/**
+	 * \return the value, a shared value is cloned first.
+	 */
+	T& get()
+	{
+		// the flag is loaded first, unshare clears it after it published the clone:
+		if (std::atomic_ref<uint8_t>(bShared).load(std::memory_order_acquire)) {
+			return unshare();
+		}
+		T* ptr = std::atomic_ref<T*>(valuePtr).load(std::memory_order_acquire);
+		return ptr ? *ptr : unshare();
+	}
+	/**
+	 * \return the value without cloning it.
+	 */
+	T const& get() const
+	{
+		T const* ptr = std::atomic_ref<T*>(valuePtr).load(std::memory_order_acquire);
+		return ptr ? *ptr : emptyValue();
+	}
+
+	bool isShared() const { return bShared; }
+
+private:
+	static T const& emptyValue()
+	{
+		static const T empty{};
+		return empty;
+	}
+
+	/**
+	 * Clones a shared value and creates a missing one.
+	 */
+	T& unshare()
+	{
+		std::lock_guard lock(mutex);
+		if (std::atomic_ref<uint8_t>(bShared).load(std::memory_order_relaxed)) {
+			if (value && value.use_count() > 1) {
+				retired = value;
+				value = std::make_shared<T>(*value);
+			}
+		}
+		if (!value) {
+			value = std::make_shared<T>();
+		}
+		std::atomic_ref<T*>(valuePtr).store(value.get(), std::memory_order_release);
+		std::atomic_ref<uint8_t>(bShared).store(0, std::memory_order_release);
+		return *value;
+	}
+
+	std::shared_ptr<T> value;
+	mutable T* valuePtr{ nullptr };	// value.get(), read by the const get() without locking
+	mutable uint8_t bShared{ 0 };	// 1 if the value may be shared with a copy
+	std::shared_ptr<T> retired;		// value replaced by its clone, concurrent readers may still hold it
+	std::mutex mutex;				// taken to clone a shared value or to create it
+};
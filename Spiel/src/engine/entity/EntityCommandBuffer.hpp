@@ -0,0 +1,266 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <utility>
+#include <cassert>
+#include <atomic>
+#include <mutex>
+#include <bit>
+
+#include "../JobSystem.hpp"
+#include "../types/SmallFunction.hpp"
+#include "../types/UUID.hpp"
+#include "EntityTypes.hpp"
+
+/**
+ * Records structural changes (create, destroy, addComp, remComp, spawn) for an ECM and executes them later in playback.
+ *
+ * A buffer is only used by one thread at a time, see EntityCommandBuffers for recording from jobs.
+ * The commands are executed in the order they were recorded.
+ * Commands on an entity handle that is invalid at playback (for example destroyed by an earlier command) are skipped.
+ *
+ * \tparam ECM EntityComponentManager the commands are executed on.
+ */
+template<typename ECM>
+class EntityCommandBuffer {
+public:
+	/**
+	 * Entity that is created by the buffer at playback.
+	 * It can only be used to record further commands into the same buffer.
+	 */
+	struct DeferredEntity {
+		uint32_t index;
+	};
+
+	/**
+	 * Records the creation of an entity.
+	 *
+	 * \param uuid of the new entity, an invalid uuid creates an entity without uuid.
+	 * \return deferred entity to record commands on the new entity.
+	 */
+	DeferredEntity create(UUID uuid = UUID::invalid())
+	{
+		const uint32_t index = createdCount++;
+		commands.push_back([uuid, index](ECM& world, EntityHandle* createdEntities) {
+			createdEntities[index] = world.create(uuid);
+		});
+		return DeferredEntity{ index };
+	}
+
+	void destroy(EntityHandle entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(entity)) {
+				world.destroy(entity);
+			}
+		});
+	}
+
+	void destroy(DeferredEntity entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(createdEntities[entity.index])) {
+				world.destroy(createdEntities[entity.index]);
+			}
+		});
+	}
+
+	void spawn(EntityHandle entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(entity)) {
+				world.spawn(entity);
+			}
+		});
+	}
+
+	void spawn(DeferredEntity entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(createdEntities[entity.index])) {
+				world.spawn(createdEntities[entity.index]);
+			}
+		});
+	}
+
+	void despawn(EntityHandle entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(entity)) {
+				world.despawn(entity);
+			}
+		});
+	}
+
+	/**
+	 * Records adding a component, an entity that already has the component at playback gets the given value assigned.
+	 */
+	template<typename CompType>
+	void addComp(EntityHandle entity, CompType data = CompType())
+	{
+		commands.push_back([entity, data = std::move(data)](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(entity)) {
+				addOrAssign(world, entity, data);
+			}
+		});
+	}
+
+	template<typename CompType>
+	void addComp(DeferredEntity entity, CompType data = CompType())
+	{
+		commands.push_back([entity, data = std::move(data)](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(createdEntities[entity.index])) {
+				addOrAssign(world, createdEntities[entity.index], data);
+			}
+		});
+	}
+
+	/**
+	 * Records removing a component, nothing happens if the entity does not have the component at playback.
+	 */
+	template<typename CompType>
+	void remComp(EntityHandle entity)
+	{
+		commands.push_back([entity](ECM& world, EntityHandle* createdEntities) {
+			if (world.isHandleValid(entity) && world.template hasComp<CompType>(entity)) {
+				world.template remComp<CompType>(entity);
+			}
+		});
+	}
+
+	/**
+	 * Executes and removes all recorded commands.
+	 * Commands that are recorded during the playback, for example by component callbacks, are kept for the next playback.
+	 */
+	void playback(ECM& world)
+	{
+		std::swap(commands, executingCommands);
+		createdEntities.assign(std::exchange(createdCount, 0), EntityHandle{});
+		for (auto& command : executingCommands) {
+			command(world, createdEntities.data());
+		}
+		executingCommands.clear();
+	}
+
+	bool empty() const { return commands.empty(); }
+
+	size_t size() const { return commands.size(); }
+
+private:
+	using Command = SmallFunction<void(ECM& world, EntityHandle* createdEntities)>;
+
+	template<typename CompType>
+	static void addOrAssign(ECM& world, EntityHandle entity, CompType const& data)
+	{
+		if (world.template hasComp<CompType>(entity)) {
+			world.template getComp<CompType>(entity) = data;
+		}
+		else {
+			world.template addComp<CompType>(entity, data);
+		}
+	}
+
+	std::vector<Command> commands;
+	std::vector<Command> executingCommands;
+	std::vector<EntityHandle> createdEntities;	// handles of the deferred entities, only used in playback
+	uint32_t createdCount{ 0 };
+};
+
+/**
+ * One EntityCommandBuffer per thread of the JobSystem.
+ * Jobs record structural changes into the buffer of their thread without locking,
+ * the buffers are played back at a sync point, where no job accesses the ECM.
+ *
+ * The buffers are created on first use, so a world created before the JobSystem is initialized works with any worker count.
+ * They are kept in segments that never move, segment s holds the buffers of the thread ids [2^s - 1, 2^(s+1) - 1).
+ * Only creating a segment takes a lock, later calls to local() just load the segment pointer.
+ *
+ * \tparam ECM EntityComponentManager the commands are executed on.
+ */
+template<typename ECM>
+class EntityCommandBuffers {
+public:
+	EntityCommandBuffers() = default;
+	/**
+	 * Recorded commands can not be copied, the copy of an ECM starts with empty buffers.
+	 * Snapshots of a world are taken after its update, where the buffers are empty anyway.
+	 */
+	EntityCommandBuffers(EntityCommandBuffers const& rhs) :
+		EntityCommandBuffers()
+	{}
+	EntityCommandBuffers(EntityCommandBuffers&& rhs) noexcept
+	{
+		operator=(std::move(rhs));
+	}
+	~EntityCommandBuffers()
+	{
+		clear();
+	}
+	EntityCommandBuffers& operator=(EntityCommandBuffers const& rhs)
+	{
+		if (this != &rhs) {
+			clear();
+		}
+		return *this;
+	}
+	EntityCommandBuffers& operator=(EntityCommandBuffers&& rhs) noexcept
+	{
+		if (this != &rhs) {
+			clear();
+			segments = rhs.segments;
+			rhs.segments.fill(nullptr);
+		}
+		return *this;
+	}
+
+	/**
+	 * \return buffer of the calling thread, it must be the client thread or a worker of the JobSystem.
+	 */
+	EntityCommandBuffer<ECM>& local()
+	{
+		const size_t slot = size_t(JobSystem::currentThreadId()) + 1;
+		const size_t segment = std::bit_width(slot) - 1;
+		EntityCommandBuffer<ECM>* buffers = std::atomic_ref(segments[segment]).load(std::memory_order_acquire);
+		if (!buffers) {
+			std::lock_guard lock(mutex);
+			buffers = std::atomic_ref(segments[segment]).load(std::memory_order_relaxed);
+			if (!buffers) {
+				buffers = new EntityCommandBuffer<ECM>[segmentSize(segment)];
+				std::atomic_ref(segments[segment]).store(buffers, std::memory_order_release);
+			}
+		}
+		return buffers[slot - segmentSize(segment)];
+	}
+
+	/**
+	 * Executes the commands of all buffers, one buffer after another in thread id order.
+	 * Must not be called while jobs record commands.
+	 */
+	void playback(ECM& world)
+	{
+		for (size_t segment = 0; segment < SEGMENT_COUNT; ++segment) {
+			if (segments[segment]) {
+				for (size_t i = 0; i < segmentSize(segment); ++i) {
+					segments[segment][i].playback(world);
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr size_t SEGMENT_COUNT{ 32 };	// enough segments for every 32 bit thread id
+
+	static constexpr size_t segmentSize(size_t segment) { return size_t(1) << segment; }
+
+	void clear()
+	{
+		for (auto& buffers : segments) {
+			delete[] buffers;
+			buffers = nullptr;
+		}
+	}
+
+	std::array<EntityCommandBuffer<ECM>*, SEGMENT_COUNT> segments{};	// written with atomic_ref while jobs may call local()
+	std::mutex mutex;												// taken to create a segment
+};
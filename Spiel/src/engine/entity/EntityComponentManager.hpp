@@ -1,11 +1,49 @@
 #pragma once
 
+#include <span>
+
 #include "EntityComponentManagerView.hpp"
+#include "EntityCommandBuffer.hpp"
+#include "ComponentChangeTracker.hpp"
 
 template<class ... TComponentStorage>
 class EntityComponentManager : public EntityManager {
 	using CompStoreTupleType = std::tuple<TComponentStorage...>;
 public:
+	EntityComponentManager()
+	{
+		static_assert(componentTypeCount() <= MAX_COMPONENT_TYPES, "too many component types for a ComponentSignature");
+		changeTrackers.resize(componentTypeCount());
+		forEachComponentStorage([](auto& compStorage) {
+			using CompType = typename std::remove_reference_t<decltype(compStorage)>::ComponentType;
+			compStorage.setSignatureIndex(uint32_t(componentTypeIndex<CompType>()));
+		});
+	}
+	/**
+	 * A copy is a snapshot of the world, for example to serialize it in a background job.
+	 * The storages share their memory with the copy and clone it when it is written the next time (copy on write):
+	 * - paged storages share their pages, copying them costs O(page count)
+	 * - archetype storages share their chunks, copying them costs O(chunk count) plus a flat copy of their entity locations
+	 * - paged sets share their dense arrays as a whole, so the first write after the copy clones all components of the set
+	 * The direct indexing storages, the entity slots and the query caches are copied as a whole.
+	 * rhs must not be accessed by jobs while it is copied.
+	 */
+	EntityComponentManager(EntityComponentManager const& rhs) :
+		EntityComponentManager()
+	{
+		operator=(rhs);
+	}
+	/**
+	 * Moving never copies components. The storages keep their callbacks, like in a copy.
+	 * A moved from EntityComponentManager must be assigned a new world before it is used again.
+	 */
+	EntityComponentManager(EntityComponentManager&& rhs) noexcept :
+		EntityComponentManager()
+	{
+		operator=(std::move(rhs));
+	}
+	EntityComponentManager& operator=(EntityComponentManager const& rhs) = default;
+	EntityComponentManager& operator=(EntityComponentManager&& rhs) noexcept = default;
 
 	/**
 	 * Adds a callback specific to this ECM, that is called directly after a Component is added to an entity.
@@ -77,7 +115,7 @@ public:
 
 	template<typename CompType>		bool hasComp(EntityHandleIndex index)
 	{
-		return storage<CompType>().contains(index);
+		return componentSignature(index) & signatureOf<CompType>();
 	}
 	template<typename CompType>		bool hasComp(EntityHandle entity)
 	{
@@ -86,7 +124,8 @@ public:
 
 	template<typename... CompTypes> bool hasComps(EntityHandleIndex index)
 	{
-		return (hasComp<CompTypes>(index) && ...);
+		constexpr ComponentSignature REQUIRED = signatureOf<CompTypes...>();
+		return (componentSignature(index) & REQUIRED) == REQUIRED;
 	}
 	template<typename... CompTypes> bool hasComps(EntityHandle entity)
 	{
@@ -95,7 +134,7 @@ public:
 
 	template<typename CompType>		bool hasntComp(EntityHandleIndex index)
 	{
-		return !storage<CompType>().contains(index);
+		return !hasComp<CompType>(index);
 	}
 	template<typename CompType>		bool hasntComp(EntityHandle entity)
 	{
@@ -123,6 +162,8 @@ public:
 	template<typename CompType>		CompType&	addComp(EntityHandleIndex index, CompType data = CompType())
 	{
 		storage<CompType>().insert(index, data);
+		addToSignature(index, componentTypeIndex<CompType>());
+		changeTracker<CompType>().markInserted(index, currentChangeVersion);
 		return storage<CompType>().get(index);
 	}
 	template<typename CompType>		CompType&	addComp(EntityHandle entity, CompType data = CompType())
@@ -130,9 +171,44 @@ public:
 		return addComp<CompType>(entity.index, data);
 	}
 
+	/**
+	 * Adds the same components to all given entities.
+	 * The storages are grown and reserved once for all entities, instead of once per addComp.
+	 */
+	template<typename ... CompTypes>
+	void addComps(std::span<EntityHandle const> entities, CompTypes const& ... comps)
+	{
+		(addCompsWith<CompTypes>(entities, [&](size_t i) -> CompTypes const& { return comps; }), ...);
+	}
+
+	/**
+	 * Adds a component to all given entities, the component of entities[i] is make(i).
+	 * The storage is grown and reserved once for all entities, instead of once per addComp.
+	 */
+	template<typename CompType, typename Func>
+	void addCompsWith(std::span<EntityHandle const> entities, Func&& make)
+	{
+		if (entities.empty()) return;
+		auto& compStorage = storage<CompType>();
+		EntityHandleIndex maxIndex{ 0 };
+		for (EntityHandle entity : entities) {
+			maxIndex = std::max(maxIndex, entity.index);
+		}
+		compStorage.updateMaxEntNum(maxIndex + 1);
+		if constexpr (requires { compStorage.reserve(size_t(0)); }) {
+			compStorage.reserve(compStorage.size() + entities.size());
+		}
+		for (size_t i = 0; i < entities.size(); ++i) {
+			compStorage.insert(entities[i].index, make(i));
+			addToSignature(entities[i].index, componentTypeIndex<CompType>());
+			changeTracker<CompType>().markInserted(entities[i].index, currentChangeVersion);
+		}
+	}
+
 	template<typename CompType>		void remComp(EntityHandleIndex index)
 	{
 		storage<CompType>().remove(index);
+		removeFromSignature(index, componentTypeIndex<CompType>());
 	}
 	template<typename CompType>		void remComp(EntityHandle entity)
 	{
@@ -185,33 +261,299 @@ public:
 		return subManager.entityComponentView<FirstComp, RestComps...>();
 	}
 
+	/**
+	 * Starts recording changes of the component type, every existing component counts as changed in the current version.
+	 * Added components are recorded automatically, modifications must be reported with markChanged.
+	 */
+	template<typename CompType>
+	void enableChangeTracking()
+	{
+		changeTracker<CompType>().enable(maxEntityIndex(), currentChangeVersion);
+	}
+	template<typename CompType>
+	void disableChangeTracking()
+	{
+		changeTracker<CompType>().disable();
+	}
+
+	/**
+	 * Records that the component of the entity was modified in the current change version.
+	 * Does nothing when the change tracking of the component type is disabled.
+	 * Jobs can mark different entities concurrently.
+	 */
+	template<typename CompType>
+	void markChanged(EntityHandleIndex index)
+	{
+		changeTracker<CompType>().markChanged(index, currentChangeVersion);
+	}
+	template<typename CompType>
+	void markChanged(EntityHandle entity)
+	{
+		markChanged<CompType>(entity.index);
+	}
+
+	/**
+	 * The change version is incremented in every update, so it counts frames.
+	 * A system that processes changes incrementally keeps the version it last ran in:
+	 *
+	 * for (auto [entity, transform] : world.changedView<Transform>(lastVersion)) { ... }
+	 * lastVersion = world.changeVersion();
+	 *
+	 * Changes in the version of the last run are reported again, so no change between two runs is lost.
+	 *
+	 * \return the current change version.
+	 */
+	uint32_t changeVersion() const
+	{
+		return currentChangeVersion;
+	}
+
+	/**
+	 * \return view over the spawned entities whose component was added or marked as changed in sinceVersion or later.
+	 * Change tracking for the component type must be enabled.
+	 */
+	template<typename CompType>
+	[[nodiscard]]
+	ChangedComponentView<EntityComponentManager, CompType> changedView(uint32_t sinceVersion)
+	{
+		assert(changeTracker<CompType>().isEnabled());
+		return ChangedComponentView<EntityComponentManager, CompType>(*this, changeTracker<CompType>(), sinceVersion);
+	}
+
+	/**
+	 * Returns a cached query over the entities that have all the component types.
+	 * The query is registered on the first call, from then on its entity list is updated whenever a component is added or removed.
+	 * So iterating the query only visits matching entities, where an entityView tests every entity of its driving storage.
+	 * Registering is a structural change, it must not happen while jobs access the world.
+	 */
+	template<typename ... CompTypes>
+	[[nodiscard]]
+	EntityQueryView<EntityComponentManager, CompTypes...> query()
+	{
+		return query<CompTypes...>(Without<>{});
+	}
+
+	/**
+	 * Returns a cached query over the entities that have all the component types and none of the excluded types.
+	 */
+	template<typename ... CompTypes, typename ... ExcludedTypes>
+	[[nodiscard]]
+	EntityQueryView<EntityComponentManager, CompTypes...> query(Without<ExcludedTypes...> excluded)
+	{
+		return EntityQueryView<EntityComponentManager, CompTypes...>(*this, findOrRegisterQuery(signatureOf<CompTypes...>(), signatureOf<ExcludedTypes...>()));
+	}
+
+	/**
+	 * Structural changes (create, destroy, addComp, remComp) are not thread safe,
+	 * jobs record them into the command buffer of their thread instead, they are executed in the next update.
+	 *
+	 * \return command buffer of the calling thread, it must be the client thread or a worker of the JobSystem.
+	 */
+	EntityCommandBuffer<EntityComponentManager>& commands()
+	{
+		return commandBuffers.local();
+	}
+
 	void update()
 	{
+		commandBuffers.playback(*this);
 		executeDelayedSpawns();
 		deregisterDestroyedEntities();
 		executeDestroys();
+		currentChangeVersion += 1;
 	}
 
+	/**
+	 * Moves all entities to the lowest entity indices.
+	 * Over a long session destroyed entities leave holes that keep sparsely used pages alive in the paged storages,
+	 * compacting packs the components into as few pages as possible again.
+	 * The entities keep their order, paged sets additionally sort their dense arrays by entity index.
+	 *
+	 * Entities that are queued for destruction are destroyed first.
+	 * Handles of moved entities become invalid, systems that store entity handles patch them with the returned remap.
+	 * Components that store entity handles are patched here, see CRemapsEntityHandles.
+	 * Must be called at a sync point after update(), as recorded commands are not patched.
+	 *
+	 * \return the remap from the old to the new entity handles.
+	 */
+	EntityRemap compact()
+	{
+		deregisterDestroyedEntities();
+		executeDestroys();
+		EntityRemap remap = compactIndices();
+		std::apply([&](auto& ... compStorages) {
+			(compStorages.remapEntities(remap.newIndices), ...);
+		}, componentStorageTuple);
+		for (auto& tracker : changeTrackers) {
+			tracker.remapEntities(remap.newIndices);
+		}
+		forEachComponentStorage([&](auto& compStorage) {
+			using CompType = typename std::remove_reference_t<decltype(compStorage)>::ComponentType;
+			if constexpr (CRemapsEntityHandles<CompType>) {
+				for (auto iter = compStorage.begin(); iter != compStorage.end(); ++iter) {
+					iter.data().remapEntityHandles(remap);
+				}
+			}
+		});
+		return remap;
+	}
+
+	/**
+	 * \return storage of the component type, for component types in a storage group (like ComponentStorageArchetype) the column of the group.
+	 */
 	template<typename CompType> 
 	auto& storage()
 	{
-		return std::get<findIndexInTuple<0, CompType, CompStoreTupleType>()>(componentStorageTuple);
+		auto& compStorage = std::get<findIndexInTuple<0, CompType, CompStoreTupleType>()>(componentStorageTuple);
+		if constexpr (CComponentStorageGroup<std::remove_reference_t<decltype(compStorage)>>) {
+			return compStorage.template column<CompType>();
+		}
+		else {
+			return compStorage;
+		}
 	}
 
-protected:
-
-	void deregisterDestroyedEntities()
+	/**
+	 * Calls func(storage) for the storage of every component type, storage groups are split into their columns.
+	 */
+	template<typename Func>
+	void forEachComponentStorage(Func&& func)
 	{
 		util::tuple_for_each(componentStorageTuple,
-			[&](auto& componentStorage) {
-				for (EntityHandleIndex entity : destroyQueue) {
-					if (componentStorage.contains(entity)) {
-						componentStorage.remove(entity);
-					}
+			[&](auto& compStorage) {
+				using StorageType = std::remove_reference_t<decltype(compStorage)>;
+				if constexpr (CComponentStorageGroup<StorageType>) {
+					forEachColumn(compStorage, func, std::make_index_sequence<StorageType::COMPONENT_COUNT>());
+				}
+				else {
+					func(compStorage);
 				}
 			}
 		);
 	}
 
+	/**
+	 * \return count of component types in this ECM.
+	 */
+	static constexpr size_t componentTypeCount()
+	{
+		return (storageComponentCount<TComponentStorage>() + ...);
+	}
+
+	/**
+	 * \return signature with the bits of the given component types set.
+	 */
+	template<typename ... CompTypes>
+	static constexpr ComponentSignature signatureOf()
+	{
+		return ((ComponentSignature(1) << componentTypeIndex<CompTypes>()) | ... | ComponentSignature(0));
+	}
+
+	/**
+	 * \return unique index of the component type in this ECM, in the range [0, componentTypeCount()).
+	 */
+	template<typename CompType>
+	static constexpr size_t componentTypeIndex()
+	{
+		constexpr size_t STORAGE_INDEX = findIndexInTuple<0, CompType, CompStoreTupleType>();
+		constexpr size_t counts[] = { storageComponentCount<TComponentStorage>()... };
+		size_t index{ 0 };
+		for (size_t i = 0; i < STORAGE_INDEX; ++i) {
+			index += counts[i];
+		}
+		if constexpr (CComponentStorageGroup<std::tuple_element_t<STORAGE_INDEX, CompStoreTupleType>>) {
+			index += std::tuple_element_t<STORAGE_INDEX, CompStoreTupleType>::template componentIndex<CompType>();
+		}
+		return index;
+	}
+
+protected:
+
+	template<typename StorageType>
+	static constexpr size_t storageComponentCount()
+	{
+		if constexpr (CComponentStorageGroup<StorageType>) {
+			return StorageType::COMPONENT_COUNT;
+		}
+		else {
+			return 1;
+		}
+	}
+
+	template<typename GroupType, typename Func, size_t ... I>
+	static void forEachColumn(GroupType& group, Func& func, std::index_sequence<I...>)
+	{
+		(func(group.template column<std::tuple_element_t<I, typename GroupType::ComponentTypes>>()), ...);
+	}
+
+	using ComponentRemover = ComponentSignature(*)(EntityComponentManager& manager, EntityHandleIndex entity);
+
+	/**
+	 * Removes the component from the entity.
+	 * 
+	 * \return the signature bits of the removed components.
+	 */
+	template<typename CompType>
+	static ComponentSignature removeComponent(EntityComponentManager& manager, EntityHandleIndex entity)
+	{
+		manager.storage<CompType>().remove(entity);
+		return signatureOf<CompType>();
+	}
+	/**
+	 * Removes all components of a storage group at once, so the entity is not moved between archetypes.
+	 */
+	template<typename GroupType, size_t ... I>
+	static ComponentSignature removeGroupComponents(EntityComponentManager& manager, EntityHandleIndex entity)
+	{
+		using AnyComp = std::tuple_element_t<0, typename GroupType::ComponentTypes>;
+		manager.storage<AnyComp>().group().removeEntity(entity);
+		return signatureOf<std::tuple_element_t<I, typename GroupType::ComponentTypes>...>();
+	}
+	template<typename StorageType, size_t ... I>
+	static void addGroupRemovers(ComponentRemover*& remover, std::index_sequence<I...>)
+	{
+		// every component type of the group gets the remover of the whole group:
+		const ComponentRemover groupRemover = &removeGroupComponents<StorageType, I...>;
+		((*remover++ = groupRemover, (void)I), ...);
+	}
+
+	/**
+	 * \return function that removes a component type, indexed by componentTypeIndex.
+	 */
+	static std::array<ComponentRemover, componentTypeCount()> makeComponentRemovers()
+	{
+		std::array<ComponentRemover, componentTypeCount()> removers{};
+		ComponentRemover* remover = removers.data();
+		([&] {
+			if constexpr (CComponentStorageGroup<TComponentStorage>) {
+				addGroupRemovers<TComponentStorage>(remover, std::make_index_sequence<TComponentStorage::COMPONENT_COUNT>());
+			}
+			else {
+				*remover++ = &removeComponent<typename TComponentStorage::ComponentType>;
+			}
+		}(), ...);
+		return removers;
+	}
+
+	void deregisterDestroyedEntities()
+	{
+		// only the storages in the entity's signature are visited:
+		static const std::array<ComponentRemover, componentTypeCount()> removers = makeComponentRemovers();
+		for (EntityHandleIndex entity : destroyQueue) {
+			ComponentSignature signature = entitySlots[entity].signature;
+			while (signature) {
+				signature &= ~removers[std::countr_zero(signature)](*this, entity);
+			}
+			setSignature(entity, 0);
+		}
+	}
+
+	template<typename CompType>
+	ComponentChangeTracker& changeTracker()
+	{
+		return changeTrackers[componentTypeIndex<CompType>()];
+	}
+
 	CompStoreTupleType componentStorageTuple;
+	EntityCommandBuffers<EntityComponentManager> commandBuffers;
 };
\ No newline at end of file
@@ -7,8 +7,12 @@
 #include <tuple>
 #include <functional>
 #include <array>
+#include <variant>
+#include <utility>
 
 #include "EntityComponentStorage.hpp"
+#include "ComponentStorageArchetype.hpp"
+#include "ComponentStorageOwningGroup.hpp"
 #include "EntityManager.hpp"
 
 template<size_t I, typename T, typename TTuple>
@@ -17,11 +21,7 @@ static constexpr size_t findIndexInTuple()
 	static_assert(I < std::tuple_size<TTuple>::value, "the given component type is unknown");
 
 	using el = typename std::remove_pointer<typename std::remove_reference<typename std::tuple_element<I, TTuple>::type>::type>::type;
-	if constexpr (
-		std::is_same<ComponentStorageDirectIndexing<T>, el>::value
-		|| std::is_same<ComponentStoragePagedIndexing<T>, el>::value
-		|| std::is_same<ComponentStoragePagedSet<T>, el>::value
-		) {
+	if constexpr (el::template holdsComponent<T>()) {
 		return I;
 	}
 	else {
@@ -37,11 +37,7 @@ static constexpr size_t isTypeInStoreTuple()
 	}
 
 	using el = typename std::remove_pointer<typename std::remove_reference<typename std::tuple_element<I, TTuple>::type>::type>::type;
-	if constexpr (
-		std::is_same<ComponentStorageDirectIndexing<T>, el>::value
-		|| std::is_same<ComponentStoragePagedIndexing<T>, el>::value
-		|| std::is_same<ComponentStoragePagedSet<T>, el>::value
-		) {
+	if constexpr (el::template holdsComponent<T>()) {
 		return true;
 	}
 	else {
@@ -229,6 +225,12 @@ public:
 	template<typename CompType>		CompType& addComp(EntityHandleIndex index, CompType data = CompType())
 	{
 		storage<CompType>().insert(index, data);
+		if (storage<CompType>().signatureIndex() != NO_SIGNATURE_INDEX) {
+			entManager->addToSignature(index, storage<CompType>().signatureIndex());
+		}
+		if (ComponentChangeTracker* tracker = changeTracker<CompType>()) {
+			tracker->markInserted(index, entManager->currentChangeVersion);
+		}
 		return storage<CompType>().get(index);
 	}
 	template<typename CompType>		CompType& addComp(EntityHandle entity, CompType data = CompType())
@@ -239,12 +241,50 @@ public:
 	template<typename CompType>		void remComp(EntityHandleIndex index)
 	{
 		storage<CompType>().remove(index);
+		if (storage<CompType>().signatureIndex() != NO_SIGNATURE_INDEX) {
+			entManager->removeFromSignature(index, storage<CompType>().signatureIndex());
+		}
 	}
 	template<typename CompType>		void remComp(EntityHandle entity)
 	{
 		remComp<CompType>(entity.index);
 	}
 
+	/**
+	 * Records that the component of the entity was modified, see EntityComponentManager::markChanged.
+	 * Does nothing when the change tracking of the component type is disabled or the storage is outside of an EntityComponentManager.
+	 */
+	template<typename CompType>		void markChanged(EntityHandleIndex index)
+	{
+		if (ComponentChangeTracker* tracker = changeTracker<CompType>()) {
+			tracker->markChanged(index, entManager->currentChangeVersion);
+		}
+	}
+	template<typename CompType>		void markChanged(EntityHandle entity)
+	{
+		markChanged<CompType>(entity.index);
+	}
+
+	/**
+	 * \return the current change version of the EntityComponentManager, see EntityComponentManager::changeVersion.
+	 */
+	uint32_t changeVersion() const
+	{
+		return entManager->currentChangeVersion;
+	}
+
+	/**
+	 * \return view over the spawned entities whose component was added or marked as changed in sinceVersion or later.
+	 * Change tracking for the component type must be enabled.
+	 */
+	template<typename CompType>
+	[[nodiscard]]
+	ChangedComponentView<EntityComponentManagerView<CompStoreType...>, CompType> changedView(uint32_t sinceVersion)
+	{
+		assert(changeTracker<CompType>() && changeTracker<CompType>()->isEnabled());
+		return ChangedComponentView<EntityComponentManagerView<CompStoreType...>, CompType>(*this, *changeTracker<CompType>(), sinceVersion);
+	}
+
 	template<typename FirstComp, typename ... RestComps>
 	[[nodiscard]]
 	auto entityView()
@@ -277,10 +317,191 @@ private:
 		return entManager->getVersion(index);
 	}
 
+	/**
+	 * \return change tracker of the component type, nullptr for a storage outside of an EntityComponentManager.
+	 */
+	template<typename CompType>
+	ComponentChangeTracker* changeTracker()
+	{
+		const uint32_t signatureIndex = storage<CompType>().signatureIndex();
+		return signatureIndex != NO_SIGNATURE_INDEX ? &entManager->changeTrackers[signatureIndex] : nullptr;
+	}
+
 	EntityManager* entManager;
 	std::tuple<CompStoreType*...> compStorePtrTuple;
 };
 
+/**
+ * \return true if the storage of the component type in the ECMView keeps occupancy words.
+ */
+template<typename CompType, typename ECMView>
+static constexpr bool isOccupancyMasked()
+{
+	return COccupancyMaskedStorage<std::remove_cvref_t<decltype(std::declval<ECMView&>().template storage<CompType>())>>;
+}
+
+/**
+ * \return occupancy word of the component type's storage, all bits are set for storages without occupancy words.
+ */
+template<typename CompType, typename ECMView>
+uint64_t viewOccupancyWord(ECMView& manager, size_t wordIndex)
+{
+	if constexpr (isOccupancyMasked<CompType, ECMView>()) {
+		return manager.template storage<CompType>().occupancyWord(wordIndex);
+	}
+	else {
+		return ~uint64_t(0);
+	}
+}
+
+/**
+ * Finds the next entity a view over the component types visits.
+ * The occupancy words of all storages that keep them are AND-ed, so 64 entities that miss a component are skipped at once.
+ * Components in other storages are tested per entity.
+ *
+ * \return first spawned entity in [from, end) that has all the components, or end if there is none.
+ */
+template<typename FirstComp, typename ... RestComp, typename ECMView>
+EntityHandleIndex findNextViewEntity(ECMView& manager, EntityHandleIndex from, EntityHandleIndex end)
+{
+	static_assert(isOccupancyMasked<FirstComp, ECMView>(), "the first component type of the view must be in a storage with occupancy words");
+	while (true) {
+		from = findNextOccupied(from, end, [&](size_t wordIndex) {
+			return (viewOccupancyWord<RestComp>(manager, wordIndex) & ... & viewOccupancyWord<FirstComp>(manager, wordIndex));
+		});
+		if (from >= end) {
+			return end;
+		}
+		if (((isOccupancyMasked<RestComp, ECMView>() || manager.template hasComp<RestComp>(from)) && ...) && manager.isSpawned(from)) {
+			return from;
+		}
+		++from;
+	}
+}
+
+/*----------------------------------------------------------------------------------*/
+/*---------------------------------EntityViewDriver---------------------------------*/
+/*----------------------------------------------------------------------------------*/
+
+/**
+ * Iterates the entities that have all the given component types for EntityView and EntityComponentView.
+ *
+ * The storage with the fewest components is chosen as the driving storage on construction,
+ * its entities are iterated and tested against the other storages.
+ * So a view over a rare component does not walk every entity of a common one, independent of the order of the component types.
+ * A driving storage with occupancy words skips 64 entities at a time with findNextViewEntity.
+ */
+template<typename ECMView, typename ... Comps>
+class EntityViewDriver {
+public:
+	/**
+	 * Iterator of the driving storage, the alternative index is the index of the component type in Comps.
+	 */
+	using Iterator = std::variant<decltype(std::declval<ECMView&>().template storage<Comps>().begin())...>;
+
+	EntityViewDriver(ECMView& manager)
+	{
+		const std::array<size_t, sizeof...(Comps)> sizes{ manager.template storage<Comps>().size()... };
+		driverIndex = size_t(std::min_element(sizes.begin(), sizes.end()) - sizes.begin());
+	}
+
+	Iterator begin(ECMView& manager) const
+	{
+		return dispatchBegin(manager, std::index_sequence_for<Comps...>{});
+	}
+
+	Iterator end(ECMView& manager) const
+	{
+		return dispatchEnd(manager, std::index_sequence_for<Comps...>{});
+	}
+
+	void next(ECMView& manager, Iterator& iter) const
+	{
+		dispatchNext(manager, iter, std::index_sequence_for<Comps...>{});
+	}
+
+	static EntityHandleIndex entity(Iterator& iter)
+	{
+		return std::visit([](auto& storageIter) { return EntityHandleIndex(*storageIter); }, iter);
+	}
+
+private:
+	template<size_t I>
+	using CompAt = std::tuple_element_t<I, std::tuple<Comps...>>;
+
+	static bool matches(ECMView& manager, EntityHandleIndex entity)
+	{
+		return manager.template hasComps<Comps...>(entity) && manager.isSpawned(entity);
+	}
+
+	template<size_t I>
+	Iterator beginAt(ECMView& manager) const
+	{
+		auto& storage = manager.template storage<CompAt<I>>();
+		Iterator iter{ std::in_place_index<I>, storage.begin() };
+		auto& storageIter = std::get<I>(iter);
+		if constexpr (isOccupancyMasked<CompAt<I>, ECMView>()) {
+			storageIter.seek(findNextViewEntity<CompAt<I>, Comps...>(manager, 0, storage.occupancyEnd()));
+		}
+		else {
+			const auto storageEnd = storage.end();
+			while (storageIter != storageEnd && !matches(manager, *storageIter)) {
+				++storageIter;
+			}
+		}
+		return iter;
+	}
+
+	template<size_t I>
+	Iterator endAt(ECMView& manager) const
+	{
+		return Iterator{ std::in_place_index<I>, manager.template storage<CompAt<I>>().end() };
+	}
+
+	template<size_t I>
+	void nextAt(ECMView& manager, Iterator& iter) const
+	{
+		auto& storage = manager.template storage<CompAt<I>>();
+		auto& storageIter = std::get<I>(iter);
+		if constexpr (isOccupancyMasked<CompAt<I>, ECMView>()) {
+			storageIter.seek(findNextViewEntity<CompAt<I>, Comps...>(manager, *storageIter + 1, storage.occupancyEnd()));
+		}
+		else {
+			const auto storageEnd = storage.end();
+			do {
+				++storageIter;
+			} while (storageIter != storageEnd && !matches(manager, *storageIter));
+		}
+	}
+
+	// the driving storage is only known at runtime, so the functions for all component types are put in tables:
+	template<size_t ... I>
+	Iterator dispatchBegin(ECMView& manager, std::index_sequence<I...>) const
+	{
+		using BeginFunc = Iterator(EntityViewDriver::*)(ECMView&) const;
+		constexpr BeginFunc TABLE[]{ &EntityViewDriver::template beginAt<I>... };
+		return (this->*TABLE[driverIndex])(manager);
+	}
+
+	template<size_t ... I>
+	Iterator dispatchEnd(ECMView& manager, std::index_sequence<I...>) const
+	{
+		using EndFunc = Iterator(EntityViewDriver::*)(ECMView&) const;
+		constexpr EndFunc TABLE[]{ &EntityViewDriver::template endAt<I>... };
+		return (this->*TABLE[driverIndex])(manager);
+	}
+
+	template<size_t ... I>
+	void dispatchNext(ECMView& manager, Iterator& iter, std::index_sequence<I...>) const
+	{
+		using NextFuncPtr = void(EntityViewDriver::*)(ECMView&, Iterator&) const;
+		constexpr NextFuncPtr TABLE[]{ &EntityViewDriver::template nextAt<I>... };
+		(this->*TABLE[iter.index()])(manager, iter);
+	}
+
+	size_t driverIndex{ 0 };
+};
+
 /*----------------------------------------------------------------------------------*/
 /*-------------------------------EntityComponentView--------------------------------*/
 /*----------------------------------------------------------------------------------*/
@@ -288,40 +509,40 @@ private:
 template<typename ECMView, typename FirstComp, typename ... RestComp>
 class EntityComponentView {
 public:
+	using Driver = EntityViewDriver<ECMView, FirstComp, RestComp...>;
+
 	EntityComponentView(ECMView manager)
-		: manager{ manager }, compStore{ manager.storage<FirstComp>() }, iterEnd{ compStore.end() }
+		: manager{ manager }, driver{ this->manager }
 	{ }
 
-	template<typename MainIterT>
 	class iterator {
 	public:
-		using self_type				= iterator<MainIterT>;
+		using self_type				= iterator;
 		using value_type			= std::tuple<EntityHandle, FirstComp&, RestComp&...>;
 		using reference				= EntityHandle&;
 		using pointer				= EntityHandle*;
 		using iterator_category		= std::forward_iterator_tag;
 
-		iterator(const MainIterT iter, EntityComponentView<ECMView, FirstComp, RestComp...>& vw)
+		iterator(typename Driver::Iterator iter, EntityComponentView<ECMView, FirstComp, RestComp...>& vw)
 			: iter{ iter }, view{ vw }
 		{ }
 		self_type operator++()
 		{
-			do {
-				++iter;
-			} while (iter != view.iterEnd && (!view.manager.hasComps<RestComp...>(*iter) || !view.manager.isSpawned(*iter)));
+			view.driver.next(view.manager, iter);
 			return *this;
 		}
 		self_type operator++(int junk)
 		{
 			auto oldme = *this;
-			operator++(0);
+			operator++();
 			return oldme;
 		}
 		value_type operator*()
 		{
+			const EntityHandleIndex entity = Driver::entity(iter);
 			return std::tuple_cat(
-				std::tuple<EntityHandle, FirstComp&>(EntityHandle{ *iter, view.manager.getVersion(*iter) }, iter.data()),
-				view.manager.getComps<RestComp...>(*iter)
+				std::tuple<EntityHandle>(EntityHandle{ entity, view.manager.getVersion(entity) }),
+				view.manager.getComps<FirstComp, RestComp...>(entity)
 			);
 		}
 		bool operator==(const self_type& rhs) const
@@ -333,27 +554,22 @@ public:
 			return iter != rhs.iter;
 		}
 	private:
-		MainIterT iter;
+		typename Driver::Iterator iter;
 		EntityComponentView<ECMView, FirstComp, RestComp...>& view;
 	};
 
 	auto begin()
 	{
-		auto iter = compStore.begin();
-		while (iter != iterEnd && (!manager.hasComps<RestComp...>(*iter) || !manager.isSpawned(*iter))) {
-			++iter;
-		}
-		return iterator(iter, *this);
+		return iterator(driver.begin(manager), *this);
 	}
 
 	auto end()
 	{
-		return iterator(iterEnd, *this);
+		return iterator(driver.end(manager), *this);
 	}
 protected:
 	ECMView manager;
-	decltype(manager.storage<FirstComp>())& compStore;
-	const decltype(compStore.end()) iterEnd;
+	Driver driver;
 };
 
 /*----------------------------------------------------------------------------------*/
@@ -363,37 +579,37 @@ protected:
 template<typename ECMView, typename FirstComp, typename ... RestComp>
 class EntityView {
 public:
+	using Driver = EntityViewDriver<ECMView, FirstComp, RestComp...>;
+
 	EntityView(ECMView manager)
-		: manager{ manager }, compStore{ manager.storage<FirstComp>() }, iterEnd{ compStore.end() }
+		: manager{ manager }, driver{ this->manager }
 	{ }
-	template<typename MainIterT>
 	class iterator {
 	public:
-		using self_type = iterator<MainIterT>;
+		using self_type = iterator;
 		using value_type = EntityHandle;
 		using reference = EntityHandle&;
 		using pointer = EntityHandle*;
 		using iterator_category = std::forward_iterator_tag;
 
-		iterator(const MainIterT iter, EntityView& vw)
+		iterator(typename Driver::Iterator iter, EntityView& vw)
 			: iter{ iter }, view{ vw }
 		{ }
 		self_type operator++()
 		{
-			do {
-				++iter;
-			} while (iter != view.iterEnd && (!view.manager.hasComps<RestComp...>(*iter) || !view.manager.isSpawned(*iter)));
+			view.driver.next(view.manager, iter);
 			return *this;
 		}
 		self_type operator++(int junk)
 		{
 			auto oldme = *this;
-			operator++(0);
+			operator++();
 			return oldme;
 		}
 		value_type operator*()
 		{
-			return EntityHandle{ *iter, view.manager.getVersion(*iter) };
+			const EntityHandleIndex entity = Driver::entity(iter);
+			return EntityHandle{ entity, view.manager.getVersion(entity) };
 		}
 		bool operator==(const self_type& rhs) const
 		{
@@ -404,23 +620,18 @@ public:
 			return iter != rhs.iter;
 		}
 	private:
-		MainIterT iter;
+		typename Driver::Iterator iter;
 		EntityView& view;
 	};
 	auto begin()
 	{
-		auto iter = compStore.begin();
-		while (iter != iterEnd && (!manager.hasComps<RestComp...>(*iter) || !manager.isSpawned(*iter))) {
-			++iter;
-		}
-		return iterator(iter, *this);
+		return iterator(driver.begin(manager), *this);
 	}
 	auto end()
 	{
-		return iterator(iterEnd, *this);
+		return iterator(driver.end(manager), *this);
 	}
 private:
 	ECMView manager;
-	decltype(manager.storage<FirstComp>())& compStore;
-	const decltype(compStore.end()) iterEnd;
-};
\ No newline at end of file
+	Driver driver;
+};
@@ -6,8 +6,15 @@
 #include <variant>
 #include <tuple>
 #include <vector>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+#include <span>
 
 #include "EntityTypes.hpp"
+#include "CopyOnWritePages.hpp"
 
 #ifdef _DEBUG
 #define DEBUG_COMPONENT_STORAGE
@@ -33,6 +40,14 @@ using ComponentCallback = std::function<void(EntityHandleIndex, CompType&)>;
 template<typename CompType>
 class ComponentStorageBase {
 public:
+	using ComponentType = CompType;
+
+	/**
+	 * \return true if the storage holds components of type T.
+	 */
+	template<typename T>
+	static constexpr bool holdsComponent() { return std::is_same_v<T, CompType>; }
+
 	// meta:
 	void updateMaxEntNum(size_t newEntNum) { assertNoPolyNoBase(); }
 	size_t memoryConsumtion() { assertNoPolyNoBase(); }
@@ -60,9 +75,17 @@ public:
 	bool contains(EntityHandleIndex entity) const { assertNoPolyNoBase(); };
 	CompType& get(EntityHandleIndex entity) { assertNoPolyNoBase(); };
 	const CompType& get(EntityHandleIndex entity) const { assertNoPolyNoBase(); };
+
+	/**
+	 * \return bit of the component type in the entity signatures of the EntityComponentManager that owns the storage,
+	 * NO_SIGNATURE_INDEX for a storage outside of an EntityComponentManager.
+	 */
+	uint32_t signatureIndex() const { return m_signatureIndex; }
+	void setSignatureIndex(uint32_t index) { m_signatureIndex = index; }
 protected:
 	ComponentCallback<CompType> onInsertCallback;
 	ComponentCallback<CompType> onRemoveCallback;
+	uint32_t m_signatureIndex{ NO_SIGNATURE_INDEX };	// set by the EntityComponentManager that owns the storage
 private:
 	/**
 	 * This Function asserts that:
@@ -79,6 +102,49 @@ private:
 template<typename T, typename CompType>
 concept CComponentStorageType = std::is_base_of_v<ComponentStorageBase<CompType>, T>;
 
+static constexpr size_t OCCUPANCY_WORD_BITS{ 64 };
+
+/**
+ * Concept for storages that keep one bit per entity in 64 bit occupancy words.
+ * Bit i of occupancyWord(w) is set if the entity w * 64 + i has a component in the storage.
+ * All bits at or after occupancyEnd() are zero.
+ * Views and iterators use the words to test 64 entities at a time.
+ */
+template<typename T>
+concept COccupancyMaskedStorage = requires(T const& storage, size_t wordIndex) {
+	{ storage.occupancyWord(wordIndex) } -> std::same_as<uint64_t>;
+	{ storage.occupancyEnd() } -> std::same_as<EntityHandleIndex>;
+};
+
+/**
+ * Finds the next set bit in occupancy words, skips zero words as a whole.
+ *
+ * \param from first entity that is tested.
+ * \param end entity after the last entity that is tested.
+ * \param word function that returns the occupancy word with the given index.
+ * \return first entity in [from, end) with a set bit, or end if there is none.
+ */
+template<typename WordFunc>
+EntityHandleIndex findNextOccupied(EntityHandleIndex from, EntityHandleIndex end, WordFunc&& word)
+{
+	if (from >= end) return end;
+	const size_t endWord = (size_t(end) + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS;
+	size_t wordIndex = from / OCCUPANCY_WORD_BITS;
+	uint64_t bits = word(wordIndex) & (~uint64_t(0) << (from % OCCUPANCY_WORD_BITS));
+	while (!bits) {
+		if (++wordIndex >= endWord) return end;
+		bits = word(wordIndex);
+	}
+	return std::min(EntityHandleIndex(wordIndex * OCCUPANCY_WORD_BITS + std::countr_zero(bits)), end);
+}
+
+/**
+ * Concept for a storage that holds several component types, like ComponentStorageArchetype or ComponentStorageOwningGroup.
+ * Such a storage gives access to the storage of one of its component types with column<CompType>().
+ */
+template<typename T>
+concept CComponentStorageGroup = T::IS_STORAGE_GROUP;
+
 /*----------------------------------------------------------------------------------*/
 /*---------------------------------Direct-Indexing----------------------------------*/
 /*----------------------------------------------------------------------------------*/
@@ -86,6 +152,14 @@ concept CComponentStorageType = std::is_base_of_v<ComponentStorageBase<CompType>
 template<typename CompType>
 class ComponentStorageDirectIndexing : public ComponentStorageBase<CompType> {
 public:
+	ComponentStorageDirectIndexing() = default;
+	ComponentStorageDirectIndexing(ComponentStorageDirectIndexing<CompType> const& rhs) = default;
+	ComponentStorageDirectIndexing(ComponentStorageDirectIndexing<CompType>&& rhs) noexcept :
+		ComponentStorageBase<CompType>(std::move(rhs)),
+		m_size{ std::exchange(rhs.m_size, 0) },
+		storage{ std::move(rhs.storage) },
+		occupancy{ std::move(rhs.occupancy) }
+	{}
 	~ComponentStorageDirectIndexing()
 	{
 		onRemoveCallbackOnEverything();
@@ -95,28 +169,42 @@ public:
 	{
 		onRemoveCallbackOnEverything();
 		this->storage = rhs.storage;
-		this->containsVec = rhs.containsVec;
+		this->occupancy = rhs.occupancy;
+		this->m_size = rhs.m_size;
+		return *this;
+	}
+	ComponentStorageDirectIndexing<CompType>& operator=(ComponentStorageDirectIndexing<CompType>&& rhs) noexcept
+	{
+		onRemoveCallbackOnEverything();
+		this->storage = std::move(rhs.storage);
+		this->occupancy = std::move(rhs.occupancy);
+		this->m_size = std::exchange(rhs.m_size, 0);
 		return *this;
 	}
 
 	// meta:
 	void updateMaxEntNum(size_t newEntNum)
 	{
-		if (containsVec.size() < newEntNum) {
-			containsVec.resize(newEntNum, false);
+		const size_t wordCount = (newEntNum + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS;
+		if (occupancy.size() < wordCount) {
+			occupancy.resize(wordCount, 0);
+		}
+		// insert calls this for every component, so the capacity grows geometrically:
+		if (storage.capacity() < newEntNum) {
+			storage.reserve(std::max(newEntNum, 2 * storage.capacity()));
 		}
 	}
 	size_t memoryConsumtion() {
-		return storage.capacity() * sizeof(CompType);
+		return storage.capacity() * sizeof(CompType) + occupancy.capacity() * sizeof(uint64_t);
 	}
-	size_t size() const { return storage.size(); }
+	size_t size() const { return m_size; }
 
 	// access:
 	void insert(EntityHandleIndex entity, CompType const& comp)
 	{
+		updateMaxEntNum(entity + 1);
 		compStoreAssert(!contains(entity));
-		if (entity >= containsVec.size()) containsVec.resize(entity + 1, false);
-		containsVec[entity] = true;
+		occupancy[entity / OCCUPANCY_WORD_BITS] |= bit(entity);
 		if (entity < storage.size()) {
 			storage[entity] = comp;
 		}
@@ -127,6 +215,7 @@ public:
 			storage.resize(entity + 1, CompType());
 			storage[entity] = comp;
 		}
+		++m_size;
 
 		if (this->onInsertCallback) {
 			this->onInsertCallback(entity, storage[entity]);
@@ -140,12 +229,21 @@ public:
 			this->onRemoveCallback(entity, get(entity));
 		}
 
-		containsVec[entity] = false;
+		occupancy[entity / OCCUPANCY_WORD_BITS] &= ~bit(entity);
+		--m_size;
 	}
 	bool contains(EntityHandleIndex entity) const
 	{
-		compStoreAssert(entity < containsVec.size());
-		return containsVec[entity];
+		compStoreAssert(entity / OCCUPANCY_WORD_BITS < occupancy.size());
+		return occupancy[entity / OCCUPANCY_WORD_BITS] & bit(entity);
+	}
+	uint64_t occupancyWord(size_t wordIndex) const
+	{
+		return wordIndex < occupancy.size() ? occupancy[wordIndex] : 0;
+	}
+	EntityHandleIndex occupancyEnd() const
+	{
+		return static_cast<EntityHandleIndex>(storage.size());
 	}
 	CompType& get(EntityHandleIndex entity)
 	{
@@ -165,14 +263,11 @@ public:
 		using iterator_category = std::forward_iterator_tag;
 
 		iterator(EntityHandleIndex entity_, ComponentStorageDirectIndexing<CompType>& compStore)
-			: entity{ entity_ }, compStore{ compStore }, end{ (EntityHandleIndex)compStore.size() } {}
+			: entity{ entity_ }, compStore{ compStore }, end{ compStore.occupancyEnd() } {}
 		self_type operator++()
 		{
 			compStoreAssert(entity < end);
-			do {
-				++entity;
-			} while (entity < end && !compStore.containsVec[entity]);
-			//skip non valid entries
+			entity = findNextOccupied(entity + 1, end, [&](size_t word) { return compStore.occupancyWord(word); });
 			return *this;
 		}
 		self_type operator++(int dummy)
@@ -183,7 +278,7 @@ public:
 		}
 		reference operator*()
 		{
-			compStoreAssert(entity < end&& compStore.containsVec[entity]);
+			compStoreAssert(entity < end&& compStore.contains(entity));
 			return entity;
 		}
 		pointer operator->()
@@ -204,6 +299,13 @@ public:
 			compStoreAssert(entity < end);
 			return compStore.storage[entity];
 		}
+		/**
+		 * Moves the iterator to the given entity, or to the end if the entity is out of range.
+		 */
+		void seek(EntityHandleIndex newEntity)
+		{
+			entity = std::min(newEntity, end);
+		}
 	private:
 		EntityHandleIndex entity;
 		ComponentStorageDirectIndexing<CompType>& compStore;
@@ -211,12 +313,36 @@ public:
 	};
 	iterator<CompType> begin()
 	{
-		EntityHandleIndex entity = 0;
-		while (entity < storage.size() && !contains(entity)) ++entity;
+		EntityHandleIndex entity = findNextOccupied(0, occupancyEnd(), [&](size_t word) { return occupancyWord(word); });
 		return iterator<CompType>(entity, *this);
 	}
-	iterator<CompType> end() { return iterator<CompType>(storage.size(), *this); }
+	iterator<CompType> end() { return iterator<CompType>(occupancyEnd(), *this); }
+
+	/**
+	 * Moves the components to new entity indices, see EntityComponentManager::compact.
+	 * newIndices is indexed by the old entity index, it must keep the order of the entities and never increase an index.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices)
+	{
+		std::vector<uint64_t> newOccupancy(occupancy.size(), 0);
+		size_t newEnd = 0;
+		// moving in ascending order never overwrites a component that still has to move:
+		for (auto iter = begin(); iter != end(); ++iter) {
+			const EntityHandleIndex newEntity = newIndices[*iter];
+			if (newEntity != *iter) {
+				storage[newEntity] = std::move(storage[*iter]);
+			}
+			newOccupancy[newEntity / OCCUPANCY_WORD_BITS] |= bit(newEntity);
+			newEnd = size_t(newEntity) + 1;
+		}
+		occupancy = std::move(newOccupancy);
+		storage.erase(storage.begin() + newEnd, storage.end());
+	}
 private:
+	static uint64_t bit(EntityHandleIndex entity)
+	{
+		return uint64_t(1) << (entity % OCCUPANCY_WORD_BITS);
+	}
 
 	void onRemoveCallbackOnEverything()
 	{
@@ -226,8 +352,9 @@ private:
 			}
 		}
 	}
+	size_t m_size{ 0 };
 	std::vector<CompType> storage;
-	std::vector<bool> containsVec;
+	std::vector<uint64_t> occupancy;		// one bit per entity
 };
 
 /*----------------------------------------------------------------------------------*/
@@ -242,6 +369,10 @@ public:
 	{
 		operator=(rhs);
 	}
+	ComponentStoragePagedIndexing(ComponentStoragePagedIndexing<CompType>&& rhs) noexcept
+	{
+		operator=(std::move(rhs));
+	}
 	~ComponentStoragePagedIndexing()
 	{
 		onRemoveCallbackOnEverything();
@@ -250,36 +381,39 @@ public:
 	// meta:
 	void updateMaxEntNum(size_t newEntNum)
 	{
-		if (newEntNum > containsVec.size()) {
-			containsVec.resize(newEntNum, false);
-		}
 		if (page(EntityHandleIndex(newEntNum - 1)) + 1 > pages.size()) {
 			pages.resize(page(EntityHandleIndex(newEntNum - 1)) + 1);
 		}
 	}
 	size_t memoryConsumtion()
 	{
-		//return pages.size() * sizeof(Page*) + usedPages * PAGE_SIZE * sizeof(CompType);
-		return containsVec.size();
+		size_t s = pages.size() * sizeof(Page*);
+		for (size_t i = 0; i < pages.size(); ++i) {
+			if (pages.peek(i) != nullptr) {
+				s += sizeof(Page);
+			}
+		}
+		return s;
 	}
 	size_t size() const 
 	{
 		return m_size;
 	};
+	/**
+	 * The copy shares the pages with rhs, a page is cloned when one of the storages accesses it, see CopyOnWritePages.
+	 * So copying is cheap, but rhs must not be accessed concurrently while it is copied.
+	 */
 	void operator=(const ComponentStoragePagedIndexing<CompType>& rhs)
 	{
 		onRemoveCallbackOnEverything();
-		this->containsVec = rhs.containsVec;
-
-		this->pages.resize(rhs.pages.size());
-		for (int i = 0; i < this->pages.size(); i++) {
-			if (rhs.pages[i]) {
-				this->pages[i] = std::make_unique<Page>(*rhs.pages[i]);
-			}
-			else if (this->pages[i]) {
-				this->pages[i].reset();
-			}
-		}
+		this->m_size = rhs.m_size;
+		this->pages = rhs.pages;
+	}
+	void operator=(ComponentStoragePagedIndexing<CompType>&& rhs) noexcept
+	{
+		onRemoveCallbackOnEverything();
+		this->m_size = std::exchange(rhs.m_size, 0);
+		this->pages = std::move(rhs.pages);
 	}
 
 	// access:
@@ -289,48 +423,65 @@ public:
 		updateMaxEntNum(entity + 1);
 
 
-		if (!pages[page(entity)]) {
-			pages[page(entity)] = std::make_unique<Page>();
+		Page* entityPage = pages.page(page(entity));
+		if (!entityPage) {
+			entityPage = &pages.emplace(page(entity));
 		}
 
-		containsVec[entity] = true;
+		entityPage->occupancy[offset(entity) / OCCUPANCY_WORD_BITS] |= bit(entity);
 
-		pages[page(entity)]->data[offset(entity)] = comp;
-		pages[page(entity)]->usedCount += 1;
+		entityPage->data[offset(entity)] = comp;
+		entityPage->usedCount += 1;
 		++m_size; 
 		
 		if (this->onInsertCallback) {
-			this->onInsertCallback(entity, pages[page(entity)]->data[offset(entity)]);
+			this->onInsertCallback(entity, entityPage->data[offset(entity)]);
 		}
 	}
 	void remove(EntityHandleIndex entity)
 	{
 		compStoreAssert(contains(entity));
-		containsVec[entity] = false; 
+		Page* entityPage = pages.page(page(entity));
+		entityPage->occupancy[offset(entity) / OCCUPANCY_WORD_BITS] &= ~bit(entity);
 		
 		if (this->onRemoveCallback) {
 			this->onRemoveCallback(entity, get(entity));
 		}
 
-		pages[page(entity)]->usedCount -= 1;
+		entityPage->usedCount -= 1;
 		if constexpr (DELETE_EMPTY_PAGES) {
-			if (pages[page(entity)]->usedCount == 0) {
-				pages[page(entity)].reset();
+			if (entityPage->usedCount == 0) {
+				pages.reset(page(entity));
 			}
 		}
 		--m_size;
 	}
 	bool contains(EntityHandleIndex entity) const
 	{
-		return entity < containsVec.size() && containsVec[entity];
+		if (size_t(page(entity)) >= pages.size()) return false;
+		Page const* entityPage = pages.page(page(entity));
+		return entityPage && (entityPage->occupancy[offset(entity) / OCCUPANCY_WORD_BITS] & bit(entity));
+	}
+	uint64_t occupancyWord(size_t wordIndex) const
+	{
+		const size_t pageIndex = wordIndex / WORDS_PER_PAGE;
+		if (pageIndex >= pages.size()) return 0;
+		Page const* wordPage = pages.page(pageIndex);
+		return wordPage ? wordPage->occupancy[wordIndex % WORDS_PER_PAGE] : 0;
+	}
+	EntityHandleIndex occupancyEnd() const
+	{
+		return static_cast<EntityHandleIndex>(pages.size() * PAGE_SIZE);
 	}
 	CompType& get(EntityHandleIndex entity)
 	{
-		return pages.csat(page(entity))->data.csat(offset(entity));
+		compStoreAssert(size_t(page(entity)) < pages.size());
+		return pages.page(page(entity))->data.csat(offset(entity));
 	}
 	const CompType& get(EntityHandleIndex entity) const
 	{
-		return pages.csat(page(entity))->data.csat(offset(entity));
+		compStoreAssert(size_t(page(entity)) < pages.size());
+		return pages.page(page(entity))->data.csat(offset(entity));
 	}
 	template<typename CompType>
 	class iterator {
@@ -342,24 +493,11 @@ public:
 		using iterator_category = std::forward_iterator_tag;
 
 		iterator(EntityHandleIndex entity_, ComponentStoragePagedIndexing<CompType>& compStore)
-			: entity{ entity_ }, compStore{ compStore }, end{ (EntityHandleIndex)compStore.containsVec.size() } {}
+			: entity{ entity_ }, compStore{ compStore }, end{ compStore.occupancyEnd() } {}
 		self_type operator++()
 		{
-			++entity;
-			while (entity < end) {
-				if (compStore.pages[page(entity)] == nullptr) // skip empty pages
-				{
-					entity = (page(entity) + 1) << PAGE_BITS;
-				}
-				else if (!compStore.contains(entity)) {
-					++entity;
-				}
-				else {
-					break;
-				}
-			}
-			if (entity > end)
-				entity = end;
+			// empty pages have zero occupancy words, so they are skipped 64 entities at a time:
+			entity = findNextOccupied(entity + 1, end, [&](size_t word) { return compStore.occupancyWord(word); });
 			return *this;
 		}
 		self_type operator++(int dummy)
@@ -386,7 +524,14 @@ public:
 		}
 		CompType& data()
 		{
-			return compStore.pages[page(entity)]->data[offset(entity)];
+			return compStore.pages.page(page(entity))->data[offset(entity)];
+		}
+		/**
+		 * Moves the iterator to the given entity, or to the end if the entity is out of range.
+		 */
+		void seek(EntityHandleIndex newEntity)
+		{
+			entity = std::min(newEntity, end);
 		}
 	private:
 		EntityHandleIndex entity;
@@ -395,24 +540,33 @@ public:
 	};
 	iterator<CompType> begin()
 	{
-		EntityHandleIndex entity = 0;
-		while (entity < containsVec.size()) {
-			if (!pages[page(entity)]) // skip empty pages
-			{
-				entity = (page(entity) + 1) << PAGE_BITS;
-			}
-			else if (!contains(entity)) {
-				++entity;
+		EntityHandleIndex entity = findNextOccupied(0, occupancyEnd(), [&](size_t word) { return occupancyWord(word); });
+		return iterator<CompType>(entity, *this);
+	}
+	iterator<CompType> end() { return iterator<CompType>(occupancyEnd(), *this); }
+
+	/**
+	 * Moves the components to new entity indices, see EntityComponentManager::compact.
+	 * newIndices is indexed by the old entity index. Pages that end up empty are freed.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices)
+	{
+		CopyOnWritePages<Page> newPages;
+		for (auto iter = begin(); iter != end(); ++iter) {
+			const EntityHandleIndex newEntity = newIndices[*iter];
+			if (size_t(page(newEntity)) >= newPages.size()) {
+				newPages.resize(size_t(page(newEntity)) + 1);
 			}
-			else {
-				break;
+			Page* newPage = newPages.page(page(newEntity));
+			if (!newPage) {
+				newPage = &newPages.emplace(page(newEntity));
 			}
+			newPage->occupancy[offset(newEntity) / OCCUPANCY_WORD_BITS] |= bit(newEntity);
+			newPage->data[offset(newEntity)] = std::move(iter.data());
+			newPage->usedCount += 1;
 		}
-		if (entity > containsVec.size())
-			entity = static_cast<EntityHandleIndex>(containsVec.size());
-		return iterator<CompType>(entity, *this);
+		pages = std::move(newPages);
 	}
-	iterator<CompType> end() { return iterator<CompType>(static_cast<EntityHandleIndex>(containsVec.size()), *this); }
 
 //private:
 	static const int PAGE_BITS{ 7 };
@@ -427,9 +581,16 @@ public:
 	{
 		return entity & OFFSET_MASK;
 	}
+	static uint64_t bit(EntityHandleIndex entity)
+	{
+		return uint64_t(1) << (entity % OCCUPANCY_WORD_BITS);
+	}
 	static const bool DELETE_EMPTY_PAGES{ true };
+	static const int WORDS_PER_PAGE{ PAGE_SIZE / OCCUPANCY_WORD_BITS };
+	static_assert(PAGE_SIZE % OCCUPANCY_WORD_BITS == 0, "pages must hold whole occupancy words");
 	struct Page {
 		size_t usedCount{ 0 };
+		std::array<uint64_t, WORDS_PER_PAGE> occupancy{};	// one bit per entity of the page
 		std::array<CompType, PAGE_SIZE> data;
 	};
 
@@ -444,8 +605,7 @@ public:
 
 	size_t usedPages{ 0 };
 	size_t m_size{ 0 };
-	std::vector<std::unique_ptr<Page>> pages;
-	std::vector<bool> containsVec;
+	CopyOnWritePages<Page> pages;
 };
 
 /*----------------------------------------------------------------------------------*/
@@ -460,6 +620,10 @@ public:
 	{
 		operator=(rhs);
 	}
+	ComponentStoragePagedSet(ComponentStoragePagedSet<CompType>&& rhs) noexcept
+	{
+		operator=(std::move(rhs));
+	}
 	~ComponentStoragePagedSet()
 	{
 		onRemoveCallbackOnEverything();
@@ -473,9 +637,10 @@ public:
 	}
 	size_t memoryConsumtion()
 	{
-		size_t s = denseTable.capacity() * sizeof(EntityHandleIndex); +storage.capacity() * sizeof(CompType) + pages.size() * sizeof(Page*);
-		for (auto& page : pages) {
-			if (page != nullptr) {
+		DenseArrays const& arrays = std::as_const(dense).get();
+		size_t s = arrays.entities.capacity() * sizeof(EntityHandleIndex) + arrays.components.capacity() * sizeof(CompType) + pages.size() * sizeof(Page*);
+		for (size_t i = 0; i < pages.size(); ++i) {
+			if (pages.peek(i) != nullptr) {
 				s += sizeof(Page);
 			}
 		}
@@ -483,23 +648,32 @@ public:
 	}
 	size_t size() const
 	{
-		return denseTable.size();
+		return denseTable().size();
 	}
+	/**
+	 * Reserves the dense arrays for count components.
+	 */
+	void reserve(size_t count)
+	{
+		denseTable().reserve(count);
+		storage().reserve(count);
+	}
+	/**
+	 * The copy shares the sparse pages and the dense arrays with rhs, they are cloned when one of the storages accesses them.
+	 * So copying is cheap, but rhs must not be accessed concurrently while it is copied.
+	 * The dense arrays are shared as a whole, so the first write to them after a copy clones all components of the storage.
+	 */
 	void operator=(const ComponentStoragePagedSet<CompType>& rhs)
 	{
 		onRemoveCallbackOnEverything();
-		this->denseTable = rhs.denseTable;
-		this->storage = rhs.storage;
-
-		this->pages.resize(rhs.pages.size());
-		for (int i = 0; i < this->pages.size(); i++) {
-			if (rhs.pages[i]) {
-				this->pages[i] = std::make_unique<Page>(*rhs.pages[i]);
-			}
-			else if (this->pages[i]) {
-				this->pages[i].reset();
-			}
-		}
+		this->dense = rhs.dense;
+		this->pages = rhs.pages;
+	}
+	void operator=(ComponentStoragePagedSet<CompType>&& rhs) noexcept
+	{
+		onRemoveCallbackOnEverything();
+		this->dense = std::move(rhs.dense);
+		this->pages = std::move(rhs.pages);
 	}
 
 	// access:
@@ -507,17 +681,18 @@ public:
 	{
 		compStoreAssert(!contains(entity));
 		updateMaxEntNum(entity + 1);
-		denseTable.push_back(entity);
-		storage.push_back(comp);
+		denseTable().push_back(entity);
+		storage().push_back(comp);
 
-		if (!pages[page(entity)]) {
-			pages[page(entity)] = std::make_unique<Page>();
+		Page* entityPage = pages.page(page(entity));
+		if (!entityPage) {
+			entityPage = &pages.emplace(page(entity));
 		}
-		sparseTable(entity) = (uint32_t)denseTable.size() - 1;
-		pages[page(entity)]->usedCount++; 
+		entityPage->data[offset(entity)] = (uint32_t)denseTable().size() - 1;
+		entityPage->usedCount++; 
 		
 		if (this->onInsertCallback) {
-			this->onInsertCallback(entity, storage.back());
+			this->onInsertCallback(entity, storage().back());
 		}
 	}
 	void remove(EntityHandleIndex entity)
@@ -528,41 +703,47 @@ public:
 			this->onRemoveCallback(entity, get(entity));
 		}
 
-		if (entity == denseTable.back()) {
+		DenseArrays& arrays = dense.get();
+		Page* entityPage = pages.page(page(entity));
+		if (entity == arrays.entities.back()) {
 			sparseTable(entity) = 0xFFFFFFFF;
-			pages[page(entity)]->usedCount--;
-			denseTable.pop_back();
-			storage.pop_back();
+			entityPage->usedCount--;
+			arrays.entities.pop_back();
+			arrays.components.pop_back();
 		}
 		else {
 			uint32_t slot = sparseTable(entity);
 			sparseTable(entity) = 0xFFFFFFFF;
-			pages[page(entity)]->usedCount--;
-			EntityHandleIndex lastEnt = denseTable.back();
-			denseTable.pop_back();
+			entityPage->usedCount--;
+			EntityHandleIndex lastEnt = arrays.entities.back();
+			arrays.entities.pop_back();
 			sparseTable(lastEnt) = slot;
-			denseTable.at(slot) = lastEnt;
-			storage.at(slot) = storage.back();
-			storage.pop_back();
+			arrays.entities.at(slot) = lastEnt;
+			arrays.components.at(slot) = arrays.components.back();
+			arrays.components.pop_back();
 		}
-		compStoreAssert(pages[page(entity)]->usedCount >= 0);
+		compStoreAssert(entityPage->usedCount >= 0);
 		if constexpr (DELETE_EMPTY_PAGES) {
-			if (pages[page(entity)]->usedCount == 0) {
-				pages[page(entity)].reset();
+			if (entityPage->usedCount == 0) {
+				pages.reset(page(entity));
 			}
 		}
 	}
 	bool contains(EntityHandleIndex entity) const
 	{
-		return page(entity) < pages.size() && pages[page(entity)] != nullptr && sparseTable(entity) != 0xFFFFFFFF;
+		if (size_t(page(entity)) >= pages.size()) return false;
+		Page const* entityPage = pages.page(page(entity));
+		return entityPage != nullptr && entityPage->data[offset(entity)] != 0xFFFFFFFF;
 	}
 	CompType& get(EntityHandleIndex entity)
 	{
-		return storage.csat(pages.at(page(entity))->data.csat(offset(entity)));
+		compStoreAssert(size_t(page(entity)) < pages.size());
+		return storage().csat(std::as_const(*this).sparseTable(entity));
 	}
 	const CompType& get(EntityHandleIndex entity) const
 	{
-		return storage.csat(pages.at(page(entity))->data.csat(offset(entity)));
+		compStoreAssert(size_t(page(entity)) < pages.size());
+		return storage().csat(pages.page(page(entity))->data.csat(offset(entity)));
 	}
 
 	template<typename CompType>
@@ -570,15 +751,15 @@ public:
 	public:
 		using self_type = iterator ;
 		using value_type = EntityHandleIndex;
-		using reference = EntityHandleIndex&;
-		using pointer = EntityHandleIndex*;
+		using reference = EntityHandleIndex const&;
+		using pointer = EntityHandleIndex const*;
 
 		using iterator_category = std::forward_iterator_tag;
 		iterator(EntityHandleIndex denseTableIndex, ComponentStoragePagedSet<CompType>& compStore)
 			: denseTableIndex{ denseTableIndex }, compStore{ compStore } {}
 		self_type operator++()
 		{
-			compStoreAssert(denseTableIndex < compStore.denseTable.size());
+			compStoreAssert(denseTableIndex < std::as_const(compStore).denseTable().size());
 			++denseTableIndex;
 			return *this;
 		}
@@ -591,32 +772,32 @@ public:
 		self_type operator+(int offset)
 		{
 			auto ret = *this;
-			ret.denseTableIndex = std::clamp(int(ret.denseTableIndex + offset), -1, int(compStore.denseTable.size()));
+			ret.denseTableIndex = std::clamp(int(ret.denseTableIndex + offset), -1, int(std::as_const(compStore).denseTable().size()));
 			return ret;
 		}
 		self_type operator+=(int offset)
 		{
-			denseTableIndex = std::clamp(int(denseTableIndex + offset), -1, int(compStore.denseTable.size()));
+			denseTableIndex = std::clamp(int(denseTableIndex + offset), -1, int(std::as_const(compStore).denseTable().size()));
 			return *this;
 		}
 		self_type operator-(int offset)
 		{
 			auto ret = *this;
-			ret.denseTableIndex = std::clamp(int(ret.denseTableIndex - offset), -1, int(compStore.denseTable.size()));
+			ret.denseTableIndex = std::clamp(int(ret.denseTableIndex - offset), -1, int(std::as_const(compStore).denseTable().size()));
 			return ret;
 		}
 		self_type operator-=(int offset)
 		{
-			denseTableIndex = std::clamp(int(denseTableIndex - offset), -1, int(compStore.denseTable.size()));
+			denseTableIndex = std::clamp(int(denseTableIndex - offset), -1, int(std::as_const(compStore).denseTable().size()));
 			return *this;
 		}
 		reference operator*()
 		{
-			return compStore.denseTable[denseTableIndex];
+			return std::as_const(compStore).denseTable()[denseTableIndex];
 		}
 		pointer operator->()
 		{
-			return &compStore.denseTable[denseTableIndex];
+			return &std::as_const(compStore).denseTable()[denseTableIndex];
 		}
 		bool operator==(self_type const& rhs) const
 		{
@@ -632,14 +813,110 @@ public:
 		}
 		CompType& data()
 		{
-			return compStore.storage[denseTableIndex];
+			return compStore.storage()[denseTableIndex];
 		}
 	private:
 		EntityHandleIndex denseTableIndex;
 		ComponentStoragePagedSet<CompType>& compStore;
 	};
 	iterator<CompType> begin() { return iterator<CompType>(0, *this); }
-	iterator<CompType> end() { return iterator<CompType>(static_cast<EntityHandleIndex>(denseTable.size()), *this); }
+	iterator<CompType> end() { return iterator<CompType>(static_cast<EntityHandleIndex>(size()), *this); }
+
+	/**
+	 * \return index of the entity's entry in the dense arrays.
+	 */
+	size_t denseIndex(EntityHandleIndex entity) const
+	{
+		compStoreAssert(contains(entity));
+		return sparseTable(entity);
+	}
+	/**
+	 * \return dense array of the entities, index aligned with denseComponents().
+	 */
+	EntityHandleIndex const* denseEntities() const { return denseTable().data(); }
+	/**
+	 * \return dense array of the components, index aligned with denseEntities().
+	 */
+	CompType* denseComponents() { return storage().data(); }
+	/**
+	 * Swaps two entries of the dense arrays, used by ComponentStorageOwningGroup to align the entries of several storages.
+	 */
+	void swapDense(size_t a, size_t b)
+	{
+		if (a == b) return;
+		DenseArrays& arrays = dense.get();
+		std::swap(arrays.entities[a], arrays.entities[b]);
+		std::swap(arrays.components[a], arrays.components[b]);
+		sparseTable(arrays.entities[a]) = uint32_t(a);
+		sparseTable(arrays.entities[b]) = uint32_t(b);
+	}
+
+	/**
+	 * Moves the components to new entity indices, see EntityComponentManager::compact.
+	 * newIndices is indexed by the old entity index.
+	 *
+	 * \param sortDense sorts the dense arrays by the new entity index afterwards, see sortDenseRange.
+	 */
+	void remapEntities(std::span<EntityHandleIndex const> newIndices, bool sortDense = true)
+	{
+		DenseArrays& arrays = dense.get();
+		pages = CopyOnWritePages<Page>();
+		for (size_t i = 0; i < arrays.entities.size(); ++i) {
+			const EntityHandleIndex entity = newIndices[arrays.entities[i]];
+			arrays.entities[i] = entity;
+			updateMaxEntNum(entity + 1);
+			Page* entityPage = pages.page(page(entity));
+			if (!entityPage) {
+				entityPage = &pages.emplace(page(entity));
+			}
+			entityPage->data[offset(entity)] = uint32_t(i);
+			entityPage->usedCount++;
+		}
+		if (sortDense) {
+			sortDenseRange(0, arrays.entities.size());
+		}
+	}
+
+	/**
+	 * Sorts the entries [begin, end) of the dense arrays by entity index.
+	 * Iterating sorted dense arrays visits the entities in the same order as the other storages store them.
+	 */
+	void sortDenseRange(size_t begin, size_t end)
+	{
+		DenseArrays& arrays = dense.get();
+		compStoreAssert(begin <= end && end <= arrays.entities.size());
+		std::vector<uint32_t> order(end - begin);
+		std::iota(order.begin(), order.end(), uint32_t(begin));
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return arrays.entities[a] < arrays.entities[b]; });
+
+		std::vector<CompType> sortedComponents;
+		sortedComponents.reserve(order.size());
+		for (uint32_t i : order) {
+			sortedComponents.push_back(std::move(arrays.components[i]));
+		}
+		std::vector<EntityHandleIndex> sortedEntities(order.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			sortedEntities[i] = arrays.entities[order[i]];
+		}
+		for (size_t i = 0; i < order.size(); ++i) {
+			arrays.entities[begin + i] = sortedEntities[i];
+			arrays.components[begin + i] = std::move(sortedComponents[i]);
+			sparseTable(sortedEntities[i]) = uint32_t(begin + i);
+		}
+	}
+
+	/**
+	 * Calls func(EntityHandleIndex, CompType&) for the entries [begin, end) of the dense arrays.
+	 */
+	template<typename Func>
+	void forEachInDenseRange(size_t begin, size_t end, Func&& func)
+	{
+		DenseArrays& arrays = dense.get();
+		compStoreAssert(begin <= end && end <= arrays.entities.size());
+		for (size_t i = begin; i < end; ++i) {
+			func(arrays.entities[i], arrays.components[i]);
+		}
+	}
 private:
 	static const int PAGE_BITS{ 7 };
 	static const int PAGE_SIZE{ 1 << PAGE_BITS };
@@ -666,13 +943,28 @@ private:
 
 	uint32_t& sparseTable(EntityHandleIndex ent)
 	{
-		return pages.csat(page(ent))->data.csat(offset(ent));
+		compStoreAssert(size_t(page(ent)) < pages.size());
+		return pages.page(page(ent))->data.csat(offset(ent));
 	}
 	const uint32_t& sparseTable(EntityHandleIndex ent) const
 	{
-		return pages.csat(page(ent))->data.csat(offset(ent));
+		compStoreAssert(size_t(page(ent)) < pages.size());
+		return pages.page(page(ent))->data.csat(offset(ent));
 	}
 
+	/**
+	 * Dense arrays of the entities and their components, index aligned.
+	 */
+	struct DenseArrays {
+		std::vector<EntityHandleIndex> entities;
+		std::vector<CompType> components;
+	};
+
+	std::vector<EntityHandleIndex>& denseTable() { return dense.get().entities; }
+	std::vector<EntityHandleIndex> const& denseTable() const { return dense.get().entities; }
+	std::vector<CompType>& storage() { return dense.get().components; }
+	std::vector<CompType> const& storage() const { return dense.get().components; }
+
 	void onRemoveCallbackOnEverything()
 	{
 		if (this->onRemoveCallback) {
@@ -681,9 +973,8 @@ private:
 			}
 		}
 	}
-	std::vector<std::unique_ptr<Page>> pages;
-	std::vector<EntityHandleIndex> denseTable;
-	std::vector<CompType> storage;
+	CopyOnWritePages<Page> pages;
+	CopyOnWrite<DenseArrays> dense;
 };
 
 /*----------------------------------------------------------------------------------*/
@@ -5,11 +5,10 @@
 
 #include "EntityComponentManagerView.hpp"
 
-template<size_t REQUESTED_BATCH_SIZE, typename ComponentT>
-JobSystem::Tag dispatchEntityWork(ComponentStoragePagedIndexing<ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func)
+template<typename ComponentT>
+JobSystem::Tag dispatchEntityWork(ComponentStoragePagedIndexing<ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func, std::initializer_list<JobSystem::Tag> prerequisites = {})
 {
 	constexpr size_t PAGE_BITS = ComponentStoragePagedIndexing<ComponentT>::PAGE_BITS;
-	constexpr size_t PAGE_SIZE = ComponentStoragePagedIndexing<ComponentT>::PAGE_SIZE;
 
 	class WorkerJob : public IJob {
 	public:
@@ -23,11 +22,12 @@ JobSystem::Tag dispatchEntityWork(ComponentStoragePagedIndexing<ComponentT>& sto
 		virtual void execute(const uint32_t threadId) override
 		{
 			for (u32 ip = beginPage; ip < endPage; ip++) {
-				if (auto& page = storage->pages[ip]) {
-					for (u32 i = 0; i < PAGE_SIZE; ++i) {
-						u32 entIndex = (ip << PAGE_BITS) + i;
-						if (storage->contains(entIndex)) {
-							func(entIndex, page->data[i]);
+				if (auto* page = storage->pages.page(ip)) {
+					for (u32 word = 0; word < page->occupancy.size(); ++word) {
+						// visits only the set bits of the occupancy word:
+						for (u64 bits = page->occupancy[word]; bits; bits &= bits - 1) {
+							u32 i = word * OCCUPANCY_WORD_BITS + std::countr_zero(bits);
+							func((ip << PAGE_BITS) + i, page->data[i]);
 						}
 					}
 				}
@@ -40,30 +40,33 @@ JobSystem::Tag dispatchEntityWork(ComponentStoragePagedIndexing<ComponentT>& sto
 		std::function<void(EntityHandleIndex entity, ComponentT& comp)> func;
 	};
 
+	// the batch size is chosen by the JobSystem, so it scales with the entity and worker count:
+	const size_t batchSize = JobSystem::autoGrainSize(storage.size());
 	std::vector<WorkerJob> jobs;
 
 	u32 beginPage{ 0 };
 	u32 endPage{ 0 };
 	u32 entitiesInCurrentBatch{ 0 };
 	for (; endPage < storage.pages.size(); endPage++) {
-		if (entitiesInCurrentBatch >= REQUESTED_BATCH_SIZE) {
+		if (entitiesInCurrentBatch >= batchSize) {
 			jobs.emplace_back(&storage, beginPage, endPage, func);
 			beginPage = endPage;
 			entitiesInCurrentBatch = 0;
 		}
-		if (storage.pages[endPage]) {
-			entitiesInCurrentBatch += storage.pages[endPage]->usedCount;
+		// peeking does not clone pages that are shared with a snapshot, the jobs clone the pages they write to:
+		if (auto page = storage.pages.peek(endPage)) {
+			entitiesInCurrentBatch += page->usedCount;
 		}
 	}
 	if (beginPage != endPage) {
 		jobs.emplace_back(&storage, beginPage, endPage, func);
 	}
 
-	return JobSystem::submitVec(std::move(jobs));
+	return JobSystem::submitVec(std::move(jobs), prerequisites);
 }
 
-template<size_t REQUESTED_BATCH_SIZE, typename ComponentT>
-JobSystem::Tag dispatchEntityWork(ComponentStoragePagedSet<ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func) 
+template<typename ComponentT>
+JobSystem::Tag dispatchEntityWork(ComponentStoragePagedSet<ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func, std::initializer_list<JobSystem::Tag> prerequisites = {}) 
 {
 
 	class WorkerJob : public IJob {
@@ -90,16 +93,255 @@ JobSystem::Tag dispatchEntityWork(ComponentStoragePagedSet<ComponentT>& storage,
 		std::function<void(EntityHandleIndex entity, ComponentT& comp)> func;
 	};
 
+	const s32 batchSize = s32(JobSystem::autoGrainSize(storage.size()));
 	std::vector<WorkerJob> jobs;
 
-	s32 beginOffset{ 0 };
-	s32 endOffset{ 0 };
-	for (; endOffset < storage.size(); endOffset += REQUESTED_BATCH_SIZE) {
-		jobs.emplace_back(&storage, beginOffset, endOffset, func);
+	for (s32 beginOffset = 0; beginOffset < s32(storage.size()); beginOffset += batchSize) {
+		jobs.emplace_back(&storage, beginOffset, std::min(beginOffset + batchSize, s32(storage.size())), func);
 	}
-	if (endOffset != storage.size()) {
-		jobs.emplace_back(&storage, beginOffset, storage.size(), func);
+
+	return JobSystem::submitVec(std::move(jobs), prerequisites);
+}
+
+template<typename ComponentT, typename Group>
+JobSystem::Tag dispatchEntityWork(ComponentStorageArchetypeColumn<Group, ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func, std::initializer_list<JobSystem::Tag> prerequisites = {})
+{
+	using ChunkRef = typename Group::ChunkRef;
+
+	class WorkerJob : public IJob {
+	public:
+		WorkerJob(Group* group, std::vector<ChunkRef>&& chunks, std::function<void(EntityHandleIndex entity, ComponentT& comp)> const& func) :
+			group{ group },
+			chunks{ std::move(chunks) },
+			func{ func }
+		{}
+
+		virtual void execute(const uint32_t threadId) override
+		{
+			for (ChunkRef chunk : chunks) {
+				group->template forEachInChunk<ComponentT>(chunk, func);
+			}
+		}
+	private:
+		Group* group{ nullptr };
+		std::vector<ChunkRef> chunks;
+		std::function<void(EntityHandleIndex entity, ComponentT& comp)> func;
+	};
+
+	// chunks are never split, so a batch holds at least one whole chunk:
+	Group& group = storage.group();
+	const size_t batchSize = JobSystem::autoGrainSize(storage.size());
+	std::vector<WorkerJob> jobs;
+
+	std::vector<ChunkRef> batch;
+	size_t entitiesInCurrentBatch{ 0 };
+	for (ChunkRef chunk : group.template chunks<ComponentT>()) {
+		batch.push_back(chunk);
+		entitiesInCurrentBatch += group.chunkSize(chunk);
+		if (entitiesInCurrentBatch >= batchSize) {
+			jobs.emplace_back(&group, std::move(batch), func);
+			batch = {};
+			entitiesInCurrentBatch = 0;
+		}
 	}
+	if (!batch.empty()) {
+		jobs.emplace_back(&group, std::move(batch), func);
+	}
+
+	return JobSystem::submitVec(std::move(jobs), prerequisites);
+}
+
+template<typename ComponentT, typename Group>
+JobSystem::Tag dispatchEntityWork(ComponentStorageOwningGroupColumn<Group, ComponentT>& storage, std::function<void(EntityHandleIndex entity, ComponentT& comp)> func, std::initializer_list<JobSystem::Tag> prerequisites = {})
+{
+	class WorkerJob : public IJob {
+	public:
+		WorkerJob(ComponentStorageOwningGroupColumn<Group, ComponentT>* storage, size_t begin, size_t end, std::function<void(EntityHandleIndex entity, ComponentT& comp)> const& func) :
+			storage{ storage },
+			begin{ begin },
+			end{ end },
+			func{ func }
+		{}
 
-	return JobSystem::submitVec(std::move(jobs));
+		virtual void execute(const uint32_t threadId) override
+		{
+			storage->forEachInDenseRange(begin, end, func);
+		}
+	private:
+		ComponentStorageOwningGroupColumn<Group, ComponentT>* storage{ nullptr };
+		size_t begin{ 0 };
+		size_t end{ 0 };
+		std::function<void(EntityHandleIndex entity, ComponentT& comp)> func;
+	};
+
+	const size_t batchSize = JobSystem::autoGrainSize(storage.size());
+	std::vector<WorkerJob> jobs;
+
+	for (size_t beginOffset = 0; beginOffset < storage.size(); beginOffset += batchSize) {
+		jobs.emplace_back(&storage, beginOffset, std::min(beginOffset + batchSize, storage.size()), func);
+	}
+
+	return JobSystem::submitVec(std::move(jobs), prerequisites);
+}
+
+/**
+ * Implements parallelEach for a driving storage with a dense array, the dense array is split into ranges.
+ */
+template<typename DriverComp, typename ... Comps, typename ECMView, typename DriverStorage, typename Func>
+void parallelEachInDenseRanges(ECMView& view, DriverStorage& driver, Func& func, char const* label)
+{
+	JobSystem::parallelForRange(0, driver.size(),
+		[&](size_t rangeBegin, size_t rangeEnd, uint32_t threadId) {
+			driver.forEachInDenseRange(rangeBegin, rangeEnd, [&](EntityHandleIndex entity, DriverComp&) {
+				if (view.template hasComps<Comps...>(entity) && view.isSpawned(entity)) {
+					func(entity, view.template getComp<Comps>(entity)...);
+				}
+			});
+		},
+		0,
+		label
+	);
+}
+
+/**
+ * Implements parallelEach for the given driving component type.
+ */
+template<typename DriverComp, typename ... Comps, typename ECMView, typename Func>
+void parallelEachDrivenBy(ECMView& view, Func& func, char const* label)
+{
+	auto& driver = view.template storage<DriverComp>();
+	using DriverStorage = std::remove_cvref_t<decltype(driver)>;
+
+	if constexpr (COccupancyMaskedStorage<DriverStorage>) {
+		// the occupancy words of all masked storages are AND-ed, a partition is one page of the driving storage:
+		constexpr size_t WORDS_PER_PARTITION = [] {
+			if constexpr (requires { DriverStorage::WORDS_PER_PAGE; }) return size_t(DriverStorage::WORDS_PER_PAGE);
+			else return size_t(1);
+		}();
+		const size_t wordCount = (size_t(driver.occupancyEnd()) + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS;
+		const size_t partitionCount = (wordCount + WORDS_PER_PARTITION - 1) / WORDS_PER_PARTITION;
+		JobSystem::parallelForRange(0, partitionCount,
+			[&](size_t partitionBegin, size_t partitionEnd, uint32_t threadId) {
+				const size_t wordEnd = std::min(partitionEnd * WORDS_PER_PARTITION, wordCount);
+				for (size_t word = partitionBegin * WORDS_PER_PARTITION; word < wordEnd; ++word) {
+					for (u64 bits = (viewOccupancyWord<Comps>(view, word) & ...); bits; bits &= bits - 1) {
+						const EntityHandleIndex entity = EntityHandleIndex(word * OCCUPANCY_WORD_BITS + std::countr_zero(bits));
+						if (((isOccupancyMasked<Comps, ECMView>() || view.template hasComp<Comps>(entity)) && ...) && view.isSpawned(entity)) {
+							func(entity, view.template getComp<Comps>(entity)...);
+						}
+					}
+				}
+			},
+			0,
+			label
+		);
+	}
+	else if constexpr (requires { driver.group().groupSize(); }) {
+		using Group = std::remove_cvref_t<decltype(driver.group())>;
+		if constexpr (Group::template coveredBy<Comps...>() && (Group::template holdsComponent<Comps>() && ...)) {
+			// the query has exactly the components of the owning group, its entities are packed at the front of the dense arrays and are split into ranges:
+			auto& group = driver.group();
+			JobSystem::parallelForRange(0, group.groupSize(),
+				[&](size_t rangeBegin, size_t rangeEnd, uint32_t threadId) {
+					group.template forEachInGroupRange<Comps...>(rangeBegin, rangeEnd, [&](EntityHandleIndex entity, Comps&... comps) {
+						if (view.isSpawned(entity)) {
+							func(entity, comps...);
+						}
+					});
+				},
+				0,
+				label
+			);
+		}
+		else {
+			parallelEachInDenseRanges<DriverComp, Comps...>(view, driver, func, label);
+		}
+	}
+	else if constexpr (requires { driver.group(); }) {
+		// a partition is one chunk of an archetype:
+		auto& group = driver.group();
+		using Group = std::remove_cvref_t<decltype(group)>;
+		if constexpr ((Group::template holdsComponent<Comps>() && ...)) {
+			// all components are in the chunks, so they are read from the packed arrays directly:
+			const auto chunks = group.template chunks<Comps...>();
+			JobSystem::parallelForRange(0, chunks.size(),
+				[&](size_t chunkBegin, size_t chunkEnd, uint32_t threadId) {
+					for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+						group.template forEachInChunk<Comps...>(chunks[chunk], [&](EntityHandleIndex entity, Comps&... comps) {
+							if (view.isSpawned(entity)) {
+								func(entity, comps...);
+							}
+						});
+					}
+				},
+				1,
+				label
+			);
+		}
+		else {
+			const auto chunks = group.template chunks<DriverComp>();
+			JobSystem::parallelForRange(0, chunks.size(),
+				[&](size_t chunkBegin, size_t chunkEnd, uint32_t threadId) {
+					for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+						group.template forEachInChunk<DriverComp>(chunks[chunk], [&](EntityHandleIndex entity, DriverComp&) {
+							if (view.template hasComps<Comps...>(entity) && view.isSpawned(entity)) {
+								func(entity, view.template getComp<Comps>(entity)...);
+							}
+						});
+					}
+				},
+				1,
+				label
+			);
+		}
+	}
+	else {
+		parallelEachInDenseRanges<DriverComp, Comps...>(view, driver, func, label);
+	}
+}
+
+/**
+ * Calls func(EntityHandleIndex, Comps&...) for every spawned entity that has all the component types, in parallel.
+ *
+ * Like in an EntityComponentView, the storage with the fewest components drives the iteration.
+ * The work is split on the pages, occupancy words, archetype chunks or owning group ranges of the driving storage and executed with JobSystem::parallelForRange,
+ * the function returns when all entities are processed.
+ * func is a template parameter, so its body is inlined into the loops over the storages.
+ * func is called concurrently, so it must not make structural changes.
+ *
+ * \param view EntityComponentManager or EntityComponentManagerView that holds the component types.
+ * \param func callable with the signature void(EntityHandleIndex entity, Comps&... components).
+ * \param label name of the jobs in job traces.
+ */
+template<typename ... Comps, typename ECMView, typename Func>
+void parallelEach(ECMView&& view, Func&& func, char const* label = "parallelEach")
+{
+	using ViewType = std::remove_cvref_t<ECMView>;
+	const std::array<size_t, sizeof...(Comps)> sizes{ view.template storage<Comps>().size()... };
+	const size_t driverIndex = size_t(std::min_element(sizes.begin(), sizes.end()) - sizes.begin());
+	[&] <size_t ... I>(std::index_sequence<I...>) {
+		((driverIndex == I ? parallelEachDrivenBy<std::tuple_element_t<I, std::tuple<Comps...>>, Comps...>(static_cast<ViewType&>(view), func, label) : void()), ...);
+	}(std::index_sequence_for<Comps...>{});
+}
+
+/**
+ * Like parallelEach, but returns immediately. A job that runs parallelEach is queued behind the prerequisites.
+ * So a parallelEach can wait for other jobs without blocking the calling thread.
+ * view must stay alive and must not be changed structurally until the job is finished.
+ *
+ * \param prerequisites tags of job batches that must be finished before the entities are processed.
+ * \return tag of the job, it is finished when all entities are processed.
+ */
+template<typename ... Comps, typename ECMView, typename Func>
+JobSystem::Tag parallelEachAsync(ECMView& view, Func func, std::initializer_list<JobSystem::Tag> prerequisites = {}, char const* label = "parallelEach")
+{
+	return JobSystem::submit(
+		LambdaJob(
+			[&view, func = std::move(func), label](uint32_t threadId) mutable {
+				parallelEach<Comps...>(view, func, label);
+			},
+			label
+		),
+		prerequisites
+	);
 }
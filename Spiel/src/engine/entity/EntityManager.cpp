@@ -3,14 +3,14 @@
 EntityHandle EntityManager::create(UUID uuid)
 {
 	EntityHandle ent;
-	if (!freeIndexQueue.empty()) {
-		// reuse an old slot of a dead entity
-		ent.index = freeIndexQueue.front();
-		freeIndexQueue.pop_front();
+	if (!freeIndices.empty()) {
+		// reuse the lowest slot of a dead entity
+		ent.index = freeIndices.popLowest();
 		auto& slot = entitySlots[ent.index];
 		slot.valid = true;
 		slot.spawned = false;
 		slot.queuedForDestr = false;
+		slot.signature = 0;
 		ent.version = ++slot.version;
 	}
 	else {
@@ -27,6 +27,19 @@ EntityHandle EntityManager::create(UUID uuid)
 	return ent;
 }
 
+std::vector<EntityHandle> EntityManager::createMany(size_t count)
+{
+	std::vector<EntityHandle> entities;
+	entities.reserve(count);
+	if (count > freeIndices.size()) {
+		entitySlots.reserve(entitySlots.size() + count - freeIndices.size());
+	}
+	for (size_t i = 0; i < count; ++i) {
+		entities.push_back(create());
+	}
+	return entities;
+}
+
 void EntityManager::destroy(EntityHandle entity)
 {
 	if (isHandleValid(entity) && !entitySlots[entity.index].queuedForDestr) {
@@ -43,7 +56,7 @@ void EntityManager::spawnLater(EntityHandle entity)
 
 size_t const EntityManager::size()
 {
-	return entitySlots.size() - freeIndexQueue.size();
+	return entitySlots.size() - freeIndices.size();
 }
 
 size_t const EntityManager::maxEntityIndex()
@@ -51,6 +64,88 @@ size_t const EntityManager::maxEntityIndex()
 	return entitySlots.size();
 }
 
+EntityQueryCache& EntityManager::findOrRegisterQuery(ComponentSignature required, ComponentSignature excluded)
+{
+	for (auto& cache : queryCaches) {
+		if (cache.required == required && cache.excluded == excluded) {
+			return cache;
+		}
+	}
+	auto& cache = queryCaches.emplace_back();
+	cache.required = required;
+	cache.excluded = excluded;
+	fillQueryCache(cache);
+	return cache;
+}
+
+void EntityManager::fillQueryCache(EntityQueryCache& cache)
+{
+	cache.entities.clear();
+	cache.positions.clear();
+	for (EntityHandleIndex index = 0; index < entitySlots.size(); index++) {
+		if (entitySlots[index].valid && cache.matches(entitySlots[index].signature)) {
+			cache.insert(index);
+		}
+	}
+}
+
+void EntityManager::updateQueryCaches(EntityHandleIndex index, ComponentSignature oldSignature, ComponentSignature newSignature)
+{
+	for (auto& cache : queryCaches) {
+		const bool matched = cache.matches(oldSignature);
+		const bool matches = cache.matches(newSignature);
+		if (matched && !matches) {
+			cache.erase(index);
+		}
+		else if (!matched && matches) {
+			cache.insert(index);
+		}
+	}
+}
+
+EntityRemap EntityManager::compactIndices()
+{
+	assertEntityManager(destroyQueue.empty());
+	EntityRemap remap;
+	remap.newIndices.resize(entitySlots.size(), INVALID_ENTITY_HANDLE_INDEX);
+	remap.oldVersions.resize(entitySlots.size());
+	remap.newVersions.resize(entitySlots.size());
+	for (EntityHandleIndex index = 0; index < entitySlots.size(); index++) {
+		remap.oldVersions[index] = entitySlots[index].version;
+	}
+
+	// the new index is never bigger than the old one, so moving the slots in ascending order does not overwrite a slot that still has to move:
+	EntityHandleIndex next = 0;
+	for (EntityHandleIndex index = 0; index < entitySlots.size(); index++) {
+		if (!entitySlots[index].valid) continue;
+		const EntityHandleIndex newIndex = next++;
+		remap.newIndices[index] = newIndex;
+		if (newIndex != index) {
+			const EntityHandleVersion version = EntityHandleVersion(std::max(entitySlots[index].version, remap.oldVersions[newIndex]) + 1);
+			entitySlots[newIndex] = entitySlots[index];
+			entitySlots[newIndex].version = version;
+			// the old slot keeps its version, so old handles to it stay invalid when it is reused:
+			entitySlots[index] = EntitySlot();
+			entitySlots[index].version = remap.oldVersions[index];
+			if (entitySlots[newIndex].uuid.isValid()) {
+				uuidToEntityIndex[entitySlots[newIndex].uuid] = newIndex;
+			}
+		}
+		remap.newVersions[index] = entitySlots[newIndex].version;
+	}
+	freeIndices.clear();
+	freeIndices.insertRange(next, EntityHandleIndex(entitySlots.size()));
+
+	for (auto& entity : spawnLaterQueue) {
+		entity = remap(entity);
+	}
+	std::erase_if(spawnLaterQueue, [](EntityHandle entity) { return !entity.valid(); });
+	for (auto& cache : queryCaches) {
+		fillQueryCache(cache);
+	}
+	return remap;
+}
+
 EntityHandleIndex EntityManager::findBiggestValidEntityIndex()
 {
 	for (int i = entitySlots.size() - 1; i > 0; i--) {
@@ -70,7 +165,7 @@ void EntityManager::executeDestroys()
 			uuidToEntityIndex.erase(entityData.uuid);
 		}
 		entityData.uuid.invalidate();
-		freeIndexQueue.push_back(entSlotIndex);
+		freeIndices.insert(entSlotIndex);
 	}
 	destroyQueue.clear();
 }
@@ -9,7 +9,10 @@
 #include <robin_hood.h>
 
 #include "../types/UUID.hpp"
+#include "../types/IndexSet.hpp"
 #include "EntityTypes.hpp"
+#include "EntityQuery.hpp"
+#include "ComponentChangeTracker.hpp"
 
 #ifdef _DEBUG
 #define DEBUG_ENTITY_MANAGER
@@ -21,9 +24,50 @@
 #define assertEntityManager(x)
 #endif
 
+/**
+ * Maps the entity handles from before an EntityComponentManager::compact to the handles after it.
+ * Every system that stores entity handles patches them with it.
+ */
+struct EntityRemap {
+	/**
+	 * \return the handle of the entity after compacting, an invalid handle if the old handle was not valid before compacting.
+	 */
+	EntityHandle operator()(EntityHandle old) const
+	{
+		if (old.index >= newIndices.size() || newIndices[old.index] == INVALID_ENTITY_HANDLE_INDEX || oldVersions[old.index] != old.version) {
+			return EntityHandle{};
+		}
+		return EntityHandle{ newIndices[old.index], newVersions[old.index] };
+	}
+
+	std::vector<EntityHandleIndex> newIndices;		// indexed by old index, INVALID_ENTITY_HANDLE_INDEX for free slots
+	std::vector<EntityHandleVersion> oldVersions;	// indexed by old index
+	std::vector<EntityHandleVersion> newVersions;	// indexed by old index
+};
+
+/**
+ * Component types that store entity handles, EntityComponentManager::compact patches them with the remap.
+ */
+template<typename T>
+concept CRemapsEntityHandles = requires(T& component, EntityRemap const& remap) {
+	component.remapEntityHandles(remap);
+};
+
 class EntityManager {
 public:
+	EntityManager() = default;
+	EntityManager(EntityManager const& rhs) = default;
+	EntityManager(EntityManager&& rhs) noexcept = default;
+	EntityManager& operator=(EntityManager const& rhs) = default;
+	EntityManager& operator=(EntityManager&& rhs) noexcept = default;
+
 	EntityHandle create(UUID uuid = UUID::invalid());
+	/**
+	 * Creates count entities without uuid, the entity slots are allocated at once.
+	 * 
+	 * \return handles of the new entities.
+	 */
+	std::vector<EntityHandle> createMany(size_t count);
 	void destroy(EntityHandle entity);
 	void spawnLater(EntityHandle entity);
 	void spawn(EntityHandle entity)
@@ -50,6 +94,13 @@ public:
 	{
 		return isIndexValid(entity.index) && entitySlots[entity.index].version == entity.version;
 	}
+	/**
+	 * \return the component signature of the entity, bit i is set when the entity has the component type with componentTypeIndex i.
+	 */
+	ComponentSignature componentSignature(EntityHandleIndex index) const
+	{
+		return index < entitySlots.size() ? entitySlots[index].signature : 0;
+	}
 	EntityHandle getHandle(EntityHandleIndex index) const
 	{
 		assertEntityManager(isIndexValid(index));
@@ -120,6 +171,42 @@ protected:
 		return entitySlots[index].version;
 	}
 
+	void addToSignature(EntityHandleIndex index, uint32_t signatureIndex)
+	{
+		setSignature(index, entitySlots[index].signature | (ComponentSignature(1) << signatureIndex));
+	}
+
+	void removeFromSignature(EntityHandleIndex index, uint32_t signatureIndex)
+	{
+		setSignature(index, entitySlots[index].signature & ~(ComponentSignature(1) << signatureIndex));
+	}
+
+	void setSignature(EntityHandleIndex index, ComponentSignature signature)
+	{
+		const ComponentSignature old = entitySlots[index].signature;
+		entitySlots[index].signature = signature;
+		if (!queryCaches.empty() && old != signature) {
+			updateQueryCaches(index, old, signature);
+		}
+	}
+
+	/**
+	 * \return the cache of the query, it is created and filled with the matching entities on the first call.
+	 */
+	EntityQueryCache& findOrRegisterQuery(ComponentSignature required, ComponentSignature excluded);
+	void updateQueryCaches(EntityHandleIndex index, ComponentSignature oldSignature, ComponentSignature newSignature);
+	void fillQueryCache(EntityQueryCache& cache);
+
+	/**
+	 * Moves the entity slots to the lowest indices, the entities keep their order.
+	 * Entities that move get a new version, bigger than the versions of both the old and the new slot,
+	 * so handles that are not patched with the returned remap become invalid instead of pointing to another entity.
+	 * There must be no entities queued for destruction.
+	 *
+	 * \return the remap from the old to the new handles.
+	 */
+	EntityRemap compactIndices();
+
 	void executeDelayedSpawns();
 	void executeDestroys();
 	EntityHandleIndex findBiggestValidEntityIndex();
@@ -133,11 +220,15 @@ protected:
 		bool valid{ false };					// notes that the slot is not containing an entity
 		bool spawned{ false };					// used to temporarily disable entity from updates
 		bool queuedForDestr{ false };			// this is to prevent queueing an entity twice for destruction
+		ComponentSignature signature{ 0 };		// component types the entity has, maintained by the EntityComponentManager
 	};
 
 	std::vector<EntitySlot> entitySlots;
-	std::deque<EntityHandleIndex> freeIndexQueue;
+	IndexSet freeIndices;						// the lowest free index is reused first, so the entities stay packed at the front
 	std::vector<EntityHandleIndex> destroyQueue;
 	std::vector<EntityHandle> spawnLaterQueue;
 	robin_hood::unordered_map<UUID, EntityHandleIndex> uuidToEntityIndex;
+	std::deque<EntityQueryCache> queryCaches;	// a deque keeps the caches in place when a query is registered
+	std::vector<ComponentChangeTracker> changeTrackers;	// indexed by signature index, sized by the EntityComponentManager
+	uint32_t currentChangeVersion{ 1 };					// 0 is ComponentChangeTracker::NEVER_CHANGED
 };
\ No newline at end of file
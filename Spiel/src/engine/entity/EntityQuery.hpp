@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <tuple>
+#include <span>
+
+#include "EntityTypes.hpp"
+
+/**
+ * Lists the component types the entities of a query must not have, used in EntityComponentManager::query.
+ */
+template<typename ... CompTypes>
+struct Without {};
+
+/**
+ * Dense list of the entities whose component signature matches a query.
+ *
+ * The EntityManager updates the list whenever the signature of an entity changes,
+ * so it always holds exactly the matching entities and iterating it is a walk over a flat array.
+ * Adding or removing an entity swaps it with the last entity of the list.
+ */
+struct EntityQueryCache {
+	static constexpr uint32_t NOT_IN_QUERY{ 0xFFFFFFFF };
+
+	ComponentSignature required{ 0 };
+	ComponentSignature excluded{ 0 };
+	std::vector<EntityHandleIndex> entities;
+	std::vector<uint32_t> positions;	// index of the entity in entities, indexed by entity
+
+	bool matches(ComponentSignature signature) const
+	{
+		return (signature & required) == required && (signature & excluded) == 0;
+	}
+
+	void insert(EntityHandleIndex entity)
+	{
+		if (entity >= positions.size()) {
+			positions.resize(size_t(entity) + 1, NOT_IN_QUERY);
+		}
+		positions[entity] = uint32_t(entities.size());
+		entities.push_back(entity);
+	}
+
+	void erase(EntityHandleIndex entity)
+	{
+		const uint32_t position = positions[entity];
+		const EntityHandleIndex last = entities.back();
+		entities[position] = last;
+		positions[last] = position;
+		entities.pop_back();
+		positions[entity] = NOT_IN_QUERY;
+	}
+};
+
+/**
+ * Iterates over the spawned entities of a cached query, gives a tuple of the entity handle and its components like an EntityComponentView.
+ * Components of the query's component types must not be added or removed while iterating, as that reorders the list.
+ */
+template<typename ECM, typename ... CompTypes>
+class EntityQueryView {
+public:
+	EntityQueryView(ECM& manager, EntityQueryCache const& cache)
+		: manager{ manager }, cache{ cache }
+	{ }
+
+	class iterator {
+	public:
+		using self_type = iterator;
+		using value_type = std::tuple<EntityHandle, CompTypes&...>;
+		using iterator_category = std::forward_iterator_tag;
+
+		iterator(size_t position, EntityQueryView& view)
+			: position{ position }, view{ view }
+		{
+			skipDespawned();
+		}
+		self_type operator++()
+		{
+			++position;
+			skipDespawned();
+			return *this;
+		}
+		self_type operator++(int junk)
+		{
+			auto oldme = *this;
+			operator++();
+			return oldme;
+		}
+		value_type operator*()
+		{
+			const EntityHandleIndex entity = view.cache.entities[position];
+			return value_type(view.manager.getHandle(entity), view.manager.template getComp<CompTypes>(entity)...);
+		}
+		bool operator==(const self_type& rhs) const
+		{
+			return position == rhs.position;
+		}
+		bool operator!=(const self_type& rhs) const
+		{
+			return position != rhs.position;
+		}
+	private:
+		void skipDespawned()
+		{
+			while (position < view.cache.entities.size() && !view.manager.isSpawned(view.cache.entities[position])) {
+				++position;
+			}
+		}
+
+		size_t position;
+		EntityQueryView& view;
+	};
+
+	iterator begin() { return iterator(0, *this); }
+	iterator end() { return iterator(cache.entities.size(), *this); }
+
+	/**
+	 * \return all matching entities, including the ones that are not spawned.
+	 */
+	std::span<EntityHandleIndex const> entities() const { return cache.entities; }
+
+	size_t size() const { return cache.entities.size(); }
+private:
+	ECM& manager;
+	EntityQueryCache const& cache;
+};
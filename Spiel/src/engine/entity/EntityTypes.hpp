@@ -6,6 +6,14 @@ using EntityHandleVersion = uint16_t;
 static constexpr EntityHandleIndex INVALID_ENTITY_HANDLE_INDEX{ 0xFFFFFFFF };
 static constexpr EntityHandleIndex INVALID_ENTITY_HANDLE_VERSION{ 0xFFFF };
 
+/*
+* A ComponentSignature has one bit per component type of an EntityComponentManager, set when the entity has the component.
+* The bit of a component type is its componentTypeIndex.
+*/
+using ComponentSignature = uint64_t;
+static constexpr size_t MAX_COMPONENT_TYPES{ 64 };
+static constexpr uint32_t NO_SIGNATURE_INDEX{ 0xFFFFFFFF };
+
 /*
 * An EntityHandle...
 *	is used to refer to an entity in one specific world.
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "../JobSystem.hpp"
+
+/**
+ * Lists the component types a system reads, used in SystemScheduler::add.
+ */
+template<typename ... CompTypes>
+struct Reads {};
+
+/**
+ * Lists the component types a system writes, used in SystemScheduler::add.
+ */
+template<typename ... CompTypes>
+struct Writes {};
+
+/**
+ * Runs systems in parallel on the JobSystem, based on the component types they access.
+ *
+ * Every system declares the component types it reads and writes.
+ * Two systems conflict when one of them writes a component type the other one reads or writes.
+ * Systems that make structural changes (create or destroy entities, add or remove components) are added as exclusive,
+ * they conflict with every other system.
+ *
+ * On every execute the conflict graph is built from the registration order:
+ * a system waits for every earlier system it conflicts with, all other systems run concurrently.
+ * So the result is the same as running the systems one after another in registration order.
+ *
+ * \tparam ECM EntityComponentManager the systems work on.
+ */
+template<typename ECM>
+class SystemScheduler {
+public:
+	using SystemFunction = std::function<void(float deltaTime)>;
+
+	/**
+	 * Registers a system that only accesses the listed component types.
+	 *
+	 * \param name of the system.
+	 * \param reads component types the system reads.
+	 * \param writes component types the system writes.
+	 * \param function that executes the system.
+	 */
+	template<typename ... ReadTypes, typename ... WriteTypes>
+	void add(std::string name, Reads<ReadTypes...> reads, Writes<WriteTypes...> writes, SystemFunction function)
+	{
+		System system{ std::move(name), {}, {}, false, std::move(function) };
+		(system.reads.set(ECM::template componentTypeIndex<ReadTypes>()), ...);
+		(system.writes.set(ECM::template componentTypeIndex<WriteTypes>()), ...);
+		systems.push_back(std::move(system));
+	}
+
+	/**
+	 * Registers a system that makes structural changes, it never runs concurrently to another system.
+	 *
+	 * \param name of the system.
+	 * \param function that executes the system.
+	 */
+	void addExclusive(std::string name, SystemFunction function)
+	{
+		systems.push_back(System{ std::move(name), {}, {}, true, std::move(function) });
+	}
+
+	/**
+	 * Executes all systems and returns when all of them are finished.
+	 */
+	void execute(float deltaTime)
+	{
+		tags.clear();
+		for (size_t i = 0; i < systems.size(); ++i) {
+			prerequisites.clear();
+			for (size_t j = 0; j < i; ++j) {
+				if (conflicts(systems[j], systems[i])) {
+					prerequisites.push_back(tags[j]);
+				}
+			}
+			tags.push_back(JobSystem::submit(
+				LambdaJob([this, i, deltaTime](uint32_t thread) {
+					systems[i].function(deltaTime);
+				}, systems[i].name.c_str()),
+				prerequisites,
+				JobSystem::Priority::FrameCritical
+			));
+		}
+		for (auto tag : tags) {
+			JobSystem::wait(tag);
+		}
+	}
+
+	/**
+	 * Removes all systems.
+	 */
+	void clear()
+	{
+		systems.clear();
+	}
+
+	/**
+	 * \return count of registered systems.
+	 */
+	size_t size() const { return systems.size(); }
+
+private:
+	using AccessMask = std::bitset<ECM::componentTypeCount()>;
+
+	struct System {
+		std::string name;
+		AccessMask reads;
+		AccessMask writes;
+		bool bExclusive{ false };
+		SystemFunction function;
+	};
+
+	static bool conflicts(System const& a, System const& b)
+	{
+		return a.bExclusive || b.bExclusive
+			|| (a.writes & (b.reads | b.writes)).any()
+			|| (b.writes & a.reads).any();
+	}
+
+	std::deque<System> systems;	// a deque keeps the names in place, as job traces point to them
+	std::vector<JobSystem::Tag> tags;
+	std::vector<JobSystem::Tag> prerequisites;
+};
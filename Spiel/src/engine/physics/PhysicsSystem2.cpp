@@ -317,12 +317,16 @@ void PhysicsSystem2::applyImpulse(CollisionSECM world, CollisionConstraint& c)
 
 void PhysicsSystem2::applyForcefields(CollisionSECM world, PhysicsUniforms const& uniform, float deltaTime)
 {
-	for (auto [ent, p, mov, base] : world.entityComponentView<PhysicsBody, Movement, Transform>()) {
-		mov.velocity += uniform.linearEffectDir * uniform.linearEffectAccel * deltaTime;
-		mov.velocity += uniform.linearEffectDir * uniform.linearEffectForce * (1.0f / world.getComp<PhysicsBody>(ent).mass) * deltaTime;
-		mov.velocity *= (1.0f - uniform.friction * deltaTime);
-		mov.angleVelocity *= (1.0f - uniform.friction * deltaTime);
-	}
+	// linear scan over the packed arrays of the physics archetypes:
+	world.storage<PhysicsBody>().group().forEach<PhysicsBody, Movement>(
+		[&](EntityHandleIndex ent, PhysicsBody& p, Movement& mov) {
+			if (!world.isSpawned(ent)) return;
+			mov.velocity += uniform.linearEffectDir * uniform.linearEffectAccel * deltaTime;
+			mov.velocity += uniform.linearEffectDir * uniform.linearEffectForce * (1.0f / p.mass) * deltaTime;
+			mov.velocity *= (1.0f - uniform.friction * deltaTime);
+			mov.angleVelocity *= (1.0f - uniform.friction * deltaTime);
+		}
+	);
 }
 
 void PhysicsSystem2::execute(CollisionSECM world, PhysicsUniforms const& uniform, float deltaTime, CollisionSystem& collSys)
@@ -1,5 +1,9 @@
 #include "DefaultRenderer.hpp"
 
+DefaultRenderer::DefaultRenderer(ThreadConfig const& renderThreadConfig) :
+	worker{ renderThreadConfig }
+{}
+
 DefaultRenderer::~DefaultRenderer()
 {
 	if (bInitialized) {
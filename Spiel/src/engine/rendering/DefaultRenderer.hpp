@@ -33,6 +33,10 @@ struct DefaultRenderPipeline : public RenderPipeline {
 
 class DefaultRenderer {
 public:
+	/**
+	 * \param renderThreadConfig name and cpu affinity of the render thread, by default the one given to globalInitialize.
+	 */
+	DefaultRenderer(ThreadConfig const& renderThreadConfig = RenderPipelineThread::defaultConfig);
 	~DefaultRenderer();
 	void init(Window* window);
 	void reset();
@@ -1,15 +1,18 @@
 #include "RenderPipelineThread.hpp"
 
-RenderPipelineThread::RenderPipelineThread()
+RenderPipelineThread::RenderPipelineThread(ThreadConfig const& config)
 {
 	thread = std::thread(threadFunction, this);
-	thread.detach();
+	applyThreadConfig(thread, config);
 }
 RenderPipelineThread::~RenderPipelineThread()
 {
-	std::unique_lock lock(mtx);
-	killThread = true;
-	cvWorker.notify_one();
+	{
+		std::unique_lock lock(mtx);
+		killThread = true;
+		cvWorker.notify_one();
+	}
+	thread.join();
 }
 enum class Action { Init, Exec, Reset, None };
 
@@ -5,11 +5,27 @@
 #include <mutex>
 
 #include "../Window.hpp"
+#include "../../util/Thread.hpp"
 #include "RenderPipeline.hpp"
 
 class RenderPipelineThread {
 public:
-	RenderPipelineThread();
+	/**
+	 * Config of render threads that are started without one, set by globalInitialize.
+	 */
+	inline static ThreadConfig defaultConfig{ "Render Pipeline" };
+
+	/**
+	 * Starts the render thread.
+	 * 
+	 * \param config name and cpu affinity of the render thread, 
+	 * pin the JobSystem workers with JobSystem::Config::workerAffinityMasks to other cores to keep them off the render thread's core.
+	 */
+	RenderPipelineThread(ThreadConfig const& config = defaultConfig);
+
+	/**
+	 * Waits for the current action to finish and joins the render thread.
+	 */
 
 	~RenderPipelineThread();
 
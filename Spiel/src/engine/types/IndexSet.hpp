@@ -1 +1,105 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <bit>
+#include <algorithm>
+
+/**
+ * Set of indices that hands out its lowest index first.
+ *
+ * Every index is one bit in a 64 bit word, a summary word has one bit per word that is set when the word is not empty.
+ * So finding the lowest index skips 4096 absent indices per summary word.
+ * The set additionally remembers the first summary word that may be non empty, so popping the lowest index repeatedly does not rescan the front.
+ */
+class IndexSet {
+public:
+	static constexpr uint32_t WORD_BITS{ 64 };
+
+	void insert(uint32_t index)
+	{
+		const size_t word = index / WORD_BITS;
+		if (word >= words.size()) {
+			words.resize(word + 1, 0);
+			summary.resize((words.size() + WORD_BITS - 1) / WORD_BITS, 0);
+		}
+		const uint64_t bit = uint64_t(1) << (index % WORD_BITS);
+		if (!(words[word] & bit)) {
+			words[word] |= bit;
+			summary[word / WORD_BITS] |= uint64_t(1) << (word % WORD_BITS);
+			firstSummary = std::min(firstSummary, word / WORD_BITS);
+			++count;
+		}
+	}
+
+	/**
+	 * Inserts all indices in [begin, end).
+	 */
+	void insertRange(uint32_t begin, uint32_t end)
+	{
+		for (uint32_t index = begin; index < end; ++index) {
+			insert(index);
+		}
+	}
+
+	void erase(uint32_t index)
+	{
+		if (!contains(index)) return;
+		const size_t word = index / WORD_BITS;
+		words[word] &= ~(uint64_t(1) << (index % WORD_BITS));
+		if (!words[word]) {
+			summary[word / WORD_BITS] &= ~(uint64_t(1) << (word % WORD_BITS));
+		}
+		--count;
+	}
+
+	bool contains(uint32_t index) const
+	{
+		const size_t word = index / WORD_BITS;
+		return word < words.size() && (words[word] & (uint64_t(1) << (index % WORD_BITS)));
+	}
+
+	/**
+	 * \return the lowest index in the set, the set must not be empty.
+	 */
+	uint32_t lowest()
+	{
+		assert(!empty());
+		while (!summary[firstSummary]) {
+			++firstSummary;
+		}
+		const size_t word = firstSummary * WORD_BITS + std::countr_zero(summary[firstSummary]);
+		return uint32_t(word * WORD_BITS + std::countr_zero(words[word]));
+	}
+
+	/**
+	 * Removes the lowest index from the set, the set must not be empty.
+	 *
+	 * \return the removed index.
+	 */
+	uint32_t popLowest()
+	{
+		const uint32_t index = lowest();
+		erase(index);
+		return index;
+	}
+
+	size_t size() const { return count; }
+
+	bool empty() const { return count == 0; }
+
+	void clear()
+	{
+		words.clear();
+		summary.clear();
+		firstSummary = 0;
+		count = 0;
+	}
+
+private:
+	std::vector<uint64_t> words;	// bit i of word w is set when the index w * 64 + i is in the set
+	std::vector<uint64_t> summary;	// bit i of summary word s is set when the word s * 64 + i is not zero
+	size_t firstSummary{ 0 };		// no summary word before it has a set bit
+	size_t count{ 0 };
+};
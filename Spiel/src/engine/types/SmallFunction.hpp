@@ -0,0 +1,118 @@
+#pragma once
+
+#include <new>
+#include <cstddef>
+#include <cassert>
+#include <utility>
+#include <type_traits>
+
+template<typename Signature, size_t BUFFER_SIZE = 48>
+class SmallFunction;
+
+/**
+ * Type erased callable like std::function, but callables up to BUFFER_SIZE bytes are stored inside the object.
+ * Only bigger callables are allocated on the heap.
+ * SmallFunction is move only, so it also holds callables that can not be copied.
+ */
+template<typename Ret, typename... Args, size_t BUFFER_SIZE>
+class SmallFunction<Ret(Args...), BUFFER_SIZE> {
+public:
+	SmallFunction() = default;
+
+	template<typename Func> requires (!std::is_same_v<std::decay_t<Func>, SmallFunction>) && std::is_invocable_r_v<Ret, std::decay_t<Func>&, Args...>
+	SmallFunction(Func&& func)
+	{
+		using F = std::decay_t<Func>;
+		if constexpr (fitsInline<F>()) {
+			new (buffer) F(std::forward<Func>(func));
+			ops = &inlineOps<F>;
+		}
+		else {
+			new (buffer) F*(new F(std::forward<Func>(func)));
+			ops = &heapOps<F>;
+		}
+	}
+
+	SmallFunction(SmallFunction const&) = delete;
+
+	SmallFunction(SmallFunction&& other) noexcept : ops{ other.ops }
+	{
+		if (ops) {
+			ops->move(buffer, other.buffer);
+			other.ops = nullptr;
+		}
+	}
+
+	SmallFunction& operator=(SmallFunction const&) = delete;
+
+	SmallFunction& operator=(SmallFunction&& other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			ops = other.ops;
+			if (ops) {
+				ops->move(buffer, other.buffer);
+				other.ops = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	~SmallFunction()
+	{
+		reset();
+	}
+
+	Ret operator()(Args... args)
+	{
+		assert(ops);
+		return ops->invoke(buffer, std::forward<Args>(args)...);
+	}
+
+	explicit operator bool() const { return ops != nullptr; }
+
+	/**
+	 * \return true if a callable of type F would be stored inside the SmallFunction.
+	 */
+	template<typename F>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(F) <= BUFFER_SIZE && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+	}
+
+private:
+	struct Ops {
+		Ret(*invoke)(void* buffer, Args&&... args);
+		void(*move)(void* dst, void* src);		// move constructs into dst and destroys src
+		void(*destroy)(void* buffer);
+	};
+
+	template<typename F>
+	inline static const Ops inlineOps{
+		[](void* buffer, Args&&... args) -> Ret { return (*std::launder(reinterpret_cast<F*>(buffer)))(std::forward<Args>(args)...); },
+		[](void* dst, void* src) {
+			F* srcF = std::launder(reinterpret_cast<F*>(src));
+			new (dst) F(std::move(*srcF));
+			srcF->~F();
+		},
+		[](void* buffer) { std::launder(reinterpret_cast<F*>(buffer))->~F(); }
+	};
+
+	template<typename F>
+	inline static const Ops heapOps{
+		[](void* buffer, Args&&... args) -> Ret { return (**reinterpret_cast<F**>(buffer))(std::forward<Args>(args)...); },
+		[](void* dst, void* src) { new (dst) F*(*reinterpret_cast<F**>(src)); },
+		[](void* buffer) { delete *reinterpret_cast<F**>(buffer); }
+	};
+
+	void reset()
+	{
+		if (ops) {
+			ops->destroy(buffer);
+			ops = nullptr;
+		}
+	}
+
+	Ops const* ops{ nullptr };
+	alignas(std::max_align_t) std::byte buffer[BUFFER_SIZE];
+};
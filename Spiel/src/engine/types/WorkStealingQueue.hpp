@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cassert>
+#include <cinttypes>
+
+/**
+ * Lock free Chase-Lev work stealing deque.
+ * The owner thread pushes and pops at the bottom (LIFO), any other thread can steal from the top (FIFO).
+ * The memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Nardelli 2013).
+ *
+ * T must be a pointer type, nullptr is used to signal an empty queue or a failed steal.
+ * When the ring buffer is full it is replaced by one of double the size.
+ * Old buffers are kept alive until the queue is destroyed, as thieves could still read from them.
+ */
+template<typename T>
+class WorkStealingQueue {
+	static_assert(std::is_pointer_v<T>, "WorkStealingQueue can only store pointers");
+public:
+	explicit WorkStealingQueue(int64_t capacity = 1024)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);	// capacity must be a power of 2
+		buffers.push_back(std::make_unique<Buffer>(capacity));
+		buffer.store(buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingQueue(WorkStealingQueue const&) = delete;
+	WorkStealingQueue& operator=(WorkStealingQueue const&) = delete;
+
+	/**
+	 * Pushes an element to the bottom of the queue.
+	 * May ONLY be called by the owning thread.
+	 *
+	 * \param item to push, must not be nullptr.
+	 */
+	void push(T item)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		Buffer* buf = buffer.load(std::memory_order_relaxed);
+		if (b - t > buf->capacity - 1) {
+			buf = grow(buf, t, b);
+		}
+		buf->put(b, item);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Pops an element from the bottom of the queue.
+	 * May ONLY be called by the owning thread.
+	 *
+	 * \return the most recently pushed element or nullptr when the queue is empty.
+	 */
+	T pop()
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buf = buffer.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		T item{ nullptr };
+		if (t <= b) {
+			item = buf->get(b);
+			if (t == b) {
+				// last element, race against thieves:
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					item = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else {
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	/**
+	 * Steals an element from the top of the queue.
+	 * Can be called by any thread.
+	 *
+	 * \return the oldest element or nullptr when the queue is empty or the steal lost a race.
+	 */
+	T steal()
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+
+		T item{ nullptr };
+		if (t < b) {
+			Buffer* buf = buffer.load(std::memory_order_acquire);
+			item = buf->get(t);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				return nullptr;
+			}
+		}
+		return item;
+	}
+
+	/**
+	 * The result is only a snapshot, when called from a thread other than the owner it may be outdated immediately.
+	 *
+	 * \return approximate count of elements in the queue.
+	 */
+	size_t size() const
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_relaxed);
+		return b > t ? size_t(b - t) : 0;
+	}
+
+	bool empty() const { return size() == 0; }
+
+private:
+	struct Buffer {
+		explicit Buffer(int64_t capacity) :
+			capacity{ capacity }, mask{ capacity - 1 }, data{ std::make_unique<std::atomic<T>[]>(capacity) }
+		{}
+
+		T get(int64_t index) const
+		{
+			return data[index & mask].load(std::memory_order_relaxed);
+		}
+
+		void put(int64_t index, T item)
+		{
+			data[index & mask].store(item, std::memory_order_relaxed);
+		}
+
+		const int64_t capacity;
+		const int64_t mask;
+		std::unique_ptr<std::atomic<T>[]> data;
+	};
+
+	Buffer* grow(Buffer* old, int64_t t, int64_t b)
+	{
+		buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+		Buffer* newBuffer = buffers.back().get();
+		for (int64_t i = t; i < b; ++i) {
+			newBuffer->put(i, old->get(i));
+		}
+		buffer.store(newBuffer, std::memory_order_release);
+		return newBuffer;
+	}
+
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	alignas(64) std::atomic<Buffer*> buffer{ nullptr };
+	std::vector<std::unique_ptr<Buffer>> buffers;	// only accessed by the owner, keeps retired buffers alive for late thieves
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <bit>
+#include <cinttypes>
+#include <algorithm>
+
+/**
+ * Execution of one job, recorded by the JobSystem while tracing.
+ */
+struct JobTraceEvent {
+	char const* label{ nullptr };	// label of the job, must outlive the trace
+	uint64_t tag{ 0 };				// tag of the job batch the job belongs to
+	int64_t begin{ 0 };				// nanoseconds since the trace began
+	int64_t end{ 0 };				// nanoseconds since the trace began
+};
+
+/**
+ * Ring buffer of trace events, written by one thread without locks.
+ * When the buffer is full, the oldest events are overwritten.
+ * Reading is only allowed while the writing thread does not push.
+ */
+class JobTraceBuffer {
+public:
+	/**
+	 * \param capacity maximal count of stored events, rounded up to a power of two.
+	 */
+	explicit JobTraceBuffer(size_t capacity) :
+		events(std::bit_ceil(std::max<size_t>(capacity, 1))),
+		mask{ events.size() - 1 }
+	{}
+
+	void push(JobTraceEvent const& event)
+	{
+		const size_t index = written.load(std::memory_order_relaxed);
+		events[index & mask] = event;
+		written.store(index + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Calls func(JobTraceEvent const&) for all stored events, from the oldest to the newest.
+	 */
+	template<typename Func>
+	void forEach(Func&& func) const
+	{
+		const size_t end = written.load(std::memory_order_acquire);
+		const size_t begin = end > events.size() ? end - events.size() : 0;
+		for (size_t i = begin; i < end; ++i) {
+			func(events[i & mask]);
+		}
+	}
+
+	/**
+	 * \return count of events that were overwritten because the buffer was full.
+	 */
+	size_t droppedCount() const
+	{
+		const size_t end = written.load(std::memory_order_acquire);
+		return end > events.size() ? end - events.size() : 0;
+	}
+
+	size_t capacity() const { return events.size(); }
+
+	void clear()
+	{
+		written.store(0, std::memory_order_relaxed);
+	}
+private:
+	std::vector<JobTraceEvent> events;
+	size_t mask;
+	std::atomic<size_t> written{ 0 };
+};
@@ -0,0 +1,82 @@
+#include "Thread.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _WIN32
+
+static void setNativeThreadName(HANDLE handle, std::string const& name)
+{
+	std::wstring wideName(name.begin(), name.end());
+	SetThreadDescription(handle, wideName.c_str());
+}
+
+static bool setNativeThreadAffinity(HANDLE handle, uint64_t affinityMask)
+{
+	return SetThreadAffinityMask(handle, static_cast<DWORD_PTR>(affinityMask)) != 0;
+}
+
+void setThreadName(std::thread& thread, std::string const& name)
+{
+	setNativeThreadName(thread.native_handle(), name);
+}
+
+bool setThreadAffinity(std::thread& thread, uint64_t affinityMask)
+{
+	if (affinityMask == 0) return false;
+	return setNativeThreadAffinity(thread.native_handle(), affinityMask);
+}
+
+bool setCurrentThreadAffinity(uint64_t affinityMask)
+{
+	if (affinityMask == 0) return false;
+	return setNativeThreadAffinity(GetCurrentThread(), affinityMask);
+}
+
+#else
+
+static bool setNativeThreadAffinity(pthread_t handle, uint64_t affinityMask)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int core = 0; core < 64; ++core) {
+		if (affinityMask & (uint64_t(1) << core)) {
+			CPU_SET(core, &set);
+		}
+	}
+	return pthread_setaffinity_np(handle, sizeof(cpu_set_t), &set) == 0;
+}
+
+void setThreadName(std::thread& thread, std::string const& name)
+{
+	// linux only accepts names with up to 15 characters:
+	pthread_setname_np(thread.native_handle(), name.substr(0, 15).c_str());
+}
+
+bool setThreadAffinity(std::thread& thread, uint64_t affinityMask)
+{
+	if (affinityMask == 0) return false;
+	return setNativeThreadAffinity(thread.native_handle(), affinityMask);
+}
+
+bool setCurrentThreadAffinity(uint64_t affinityMask)
+{
+	if (affinityMask == 0) return false;
+	return setNativeThreadAffinity(pthread_self(), affinityMask);
+}
+
+#endif
+
+void applyThreadConfig(std::thread& thread, ThreadConfig const& config)
+{
+	if (!config.name.empty()) {
+		setThreadName(thread, config.name);
+	}
+	setThreadAffinity(thread, config.affinityMask);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <thread>
+#include <string>
+#include <cinttypes>
+
+/**
+ * Name and cpu affinity of a thread.
+ */
+struct ThreadConfig {
+	std::string name;
+	uint64_t affinityMask{ 0 };	// bit i allows the thread to run on logical core i, 0 lets the os decide
+};
+
+/**
+ * Sets the name the thread is shown with in debuggers and profilers.
+ * On linux the name is cut to 15 characters.
+ */
+void setThreadName(std::thread& thread, std::string const& name);
+
+/**
+ * Restricts the thread to the logical cores set in the mask.
+ * A mask of 0 is ignored.
+ * 
+ * \return true if the affinity was set.
+ */
+bool setThreadAffinity(std::thread& thread, uint64_t affinityMask);
+
+/**
+ * Restricts the calling thread to the logical cores set in the mask.
+ * A mask of 0 is ignored.
+ * 
+ * \return true if the affinity was set.
+ */
+bool setCurrentThreadAffinity(uint64_t affinityMask);
+
+/**
+ * Applies name and affinity of the config to the thread, an empty name is ignored.
+ */
+void applyThreadConfig(std::thread& thread, ThreadConfig const& config);
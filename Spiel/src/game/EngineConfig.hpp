@@ -4,17 +4,17 @@
 
 #include "GameComponents.hpp"
 #include "../engine/collision/CoreComponents.hpp"
+#include "../engine/collision/CollisionUniform.hpp"
 #include "../engine/entity/EntityComponentStorage.hpp"
 #include "../engine/types/BaseTypes.hpp"
 #include "../engine/rendering/OpenGLAbstraction/OpenGLTexture.hpp"
 
 #define ENGINE_COMPONENT_LIST \
-	ComponentStoragePagedIndexing<Transform>,\
+	PhysicsArchetype,\
 	ComponentStoragePagedIndexing<Draw>,\
-	ComponentStoragePagedIndexing<Collider>,\
 	ComponentStoragePagedIndexing<CollisionsToken>,\
-	ComponentStoragePagedIndexing<Movement>,\
-	ComponentStoragePagedIndexing<PhysicsBody>,\
+	ComponentStoragePagedSet<Parent>,\
+	ComponentStoragePagedSet<LocalTransform>,\
 	ComponentStoragePagedSet<TextureLoadInfo>,\
 	ComponentStoragePagedSet<TextureName>,\
 	ComponentStoragePagedSet<TextureSection>,\
@@ -1,9 +1,11 @@
 #include "Game.hpp"
 
 #include <iomanip>
+#include <fstream>
 
 #include "../engine/util/Log.hpp"
 #include "../engine/entity/EntityDispatch.hpp"
+#include "../engine/JobSystemTask.hpp"
 
 #include "GameComponents.hpp"
 #include "serialization/YAMLSerializer.hpp"
@@ -33,7 +35,32 @@ Game::Game() : EngineCore{ "Balls2", 1600, 900 }
 
 void Game::create() {
 	world.setOnRemCallback<Health>(onHealthRemCallback);
+
+	// scripts that create or destroy entities or add or remove components have to be exclusive:
+	scriptScheduler.addExclusive("health", [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<Health>()) healthScript(*this, ent, comp, deltaTime);
+	});
+	scriptScheduler.addExclusive("player", [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<Player>()) playerScript(*this, ent, comp, deltaTime);
+	});
+	// these scripts record their structural changes in the world's command buffers, so they can run concurrently:
+	scriptScheduler.add("age", Reads<>{}, Writes<Age>{}, [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<Age>()) ageScript(*this, ent, comp, deltaTime);
+	});
+	scriptScheduler.add("bullet", Reads<Age, Collider, PhysicsBody, Player>{}, Writes<Bullet, Draw, Health>{}, [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<Bullet>()) bulletScript(*this, ent, comp, deltaTime);
+	});
+	scriptScheduler.addExclusive("particle", [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<ParticleScriptComp>()) particleScript(*this, ent, comp, deltaTime);
+	});
+	scriptScheduler.add("sucker", Reads<SuckerComp, CollisionsToken, PhysicsBody, Movement>{}, Writes<Transform>{}, [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<SuckerComp>()) suckerScript(*this, ent, comp, deltaTime);
+	});
+	scriptScheduler.add("tester", Reads<>{}, Writes<Tester, Transform, Draw>{}, [&](float deltaTime) {
+		for (auto [ent, comp] : world.entityComponentView<Tester>()) testerScript(*this, ent, comp, deltaTime);
+	});
 	renderer.camera.zoom = 0.1;
+	registerQueries();
 
 #ifdef _DEBUG
 	loadBallTestMap(*this);
@@ -135,26 +162,33 @@ void Game::update(float deltaTime)
 		if (JobSystem::finished(loadingWorkerTag)) {
 			Monke::log("job with tag {0} finished clientside", (uint32_t)loadingWorkerTag);
 			bLoading = false;
-			world = loadedWorld;
+			world = std::move(loadedWorld);
+			registerQueries();
 		}
 	}
 	else {
 		collisionSystem.execute(world.submodule<COLLISION_SECM_COMPONENTS>(), deltaTime);
+		prepareRendering();
 		JobSystem::Tag renderTag = JobSystem::submit(LambdaJob(
 			[&](u32 thread) { 
 				renderingUpdate(); 
-			}
+			},
+			"renderingUpdate"
 		));
 		physicsSystem2.execute(world.submodule<COLLISION_SECM_COMPONENTS>(), world.physics, deltaTime, collisionSystem);
-		JobSystem::wait(renderTag);
-		JobSystem::Tag tag = dispatchEntityWork<128, Movement>(
-			world.storage<Movement>(), 
-			[&](u32 id, Movement& mov) { 
-				movementScript(*this, world.getHandle(id), world.getComp<Transform>(id), mov, deltaTime); 
-			}
+		// the movement scripts write the transforms the rendering reads, so they are queued behind the rendering update:
+		JobSystem::Tag movementTag = parallelEachAsync<Transform, Movement>(world,
+			[&](EntityHandleIndex id, Transform& transform, Movement& mov) {
+				movementScript(*this, world.getHandle(id), transform, mov, deltaTime);
+			},
+			{ renderTag },
+			"movementScript"
 		);
-		JobSystem::wait(tag);
+		JobSystem::orphan(renderTag);
+		JobSystem::wait(movementTag);
 		gameplayUpdate(deltaTime);
+		// children follow their parents after all systems that move entities:
+		transformHierarchySystem.execute(world.submodule<TRANSFORM_HIERARCHY_SECM_COMPONENTS>());
 
 		world.update();
 	}
@@ -238,23 +272,32 @@ void Game::gameplayUpdate(float deltaTime)
 	if (mainWindow.keyJustPressed(Key::L)) {
 		load();
 	}
+	if (mainWindow.keyJustPressed(Key::F9)) {
+		if (JobSystem::tracing()) {
+			JobSystem::endTrace();
+			std::ofstream traceFile("jobtrace.json");
+			JobSystem::writeTrace(traceFile);
+			Monke::log("wrote job trace to jobtrace.json");
+		}
+		else {
+			JobSystem::beginTrace();
+			Monke::log("started job trace, press F9 again to write it");
+		}
+	}
 
 	//execute scripts
-	for (auto [ent, comp] : world.entityComponentView<Health>()) healthScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<Player>()) playerScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<Age>()) ageScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<Bullet>()) bulletScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<ParticleScriptComp>()) particleScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<SuckerComp>()) suckerScript(*this, ent, comp, deltaTime);
-	for (auto [ent, comp] : world.entityComponentView<Tester>()) testerScript(*this, ent, comp, deltaTime);
+	scriptScheduler.execute(deltaTime);
 
 	cursorManipFunc();
 
-	for (auto ent : world.entityView<Movement, Transform>()) {
-		auto pos = world.getComp<Transform>(ent).position;
-		if (length(pos) > 1000)
-			world.destroy(ent);
-	}
+	parallelEach<Movement, Transform>(world,
+		[&](EntityHandleIndex ent, Movement& mov, Transform& transform) {
+			if (length(transform.position) > 1000) {
+				world.commands().destroy(world.getHandle(ent));
+			}
+		},
+		"outOfBoundsCleanup"
+	);
 }
 
 void Game::destroy()
@@ -427,9 +470,9 @@ void Game::cursorManipFunc()
 	//cursorManipData.oldCursorPos = getPosWorldSpace(getCursorPos());
 }
 
-void Game::renderingUpdate()
+void Game::prepareRendering()
 {
-	renderer.drawSprite(Sprite{ .color = {0.5,0.5,1,1}, .scale = {2,2} });
+	// adding components writes the signatures the physics jobs read, so it can not happen in the rendering job:
 	for (auto [ent, td] : world.entityComponentView<TextureLoadInfo>()) {
 		if (!world.hasComp<TextureSection>(ent)) {
 			world.addComp(ent, TextureSection{ renderer.tex.getHandle(td) });
@@ -440,21 +483,32 @@ void Game::renderingUpdate()
 			world.addComp(ent, TextureSection{ renderer.tex.getHandle(texName) });
 		}
 	}
-	for (auto [ent, t, d] : world.entityComponentView<Transform, Draw>()) {
-		if (!world.hasComp<ParticleScriptComp>(ent)) {
-			drawScript(*this, ent, t, d);
-		}
+}
+
+void Game::renderingUpdate()
+{
+	renderer.drawSprite(Sprite{ .color = {0.5,0.5,1,1}, .scale = {2,2} });
+	for (auto [ent, t, d] : world.query<Transform, Draw>(Without<ParticleScriptComp>{})) {
+		drawScript(*this, ent, t, d);
 	}
 	renderer.pushCommand(gl::BlendingFunction{ gl::BlendingFactor::SrcAlpha, gl::BlendingFactor::One });
-	for (auto [ent, t, d, psc] : world.entityComponentView<Transform, Draw, ParticleScriptComp>()) {
+	for (auto [ent, t, d, psc] : world.query<Transform, Draw, ParticleScriptComp>()) {
 		drawScript(*this, ent, t, d);
 	}
 	renderer.pushCommand(SpritePipe::PopBlendingFunction{});
 }
 
+void Game::registerQueries()
+{
+	// registering is a structural change, so the rendering job must find the queries already registered:
+	(void)world.query<Transform, Draw>(Without<ParticleScriptComp>{});
+	(void)world.query<Transform, Draw, ParticleScriptComp>();
+}
+
 void Game::reset()
 {
 	world = World();
+	registerQueries();
 	loadBallTestMap(*this);
 }
 
@@ -482,61 +536,68 @@ void Game::save()
 		World w;
 	};
 
-	auto tag = JobSystem::submit(SaveJob(world));
+	// the only copy of the world: it shares the pages and archetype chunks with the world, so the snapshot is cheap to take on the main thread.
+	// SaveJob and submit move it from there on:
+	auto tag = JobSystem::submit(SaveJob(world), JobSystem::Priority::Background);
 	JobSystem::orphan(tag);
 }
 
-void Game::load()
+/**
+ * Reads a whole file into a string.
+ * Reading is io, so the task moves itself to the background lane.
+ */
+static JobSystem::Task<std::string> readFileTask(std::string path)
 {
-	bLoading = true;
-
-	class LoadJob : public IJob {
-	public:
-		LoadJob(World& loadedWorld) : loadedWorld{ loadedWorld } {}
+	co_await JobSystem::schedule(JobSystem::Priority::Background);
+	std::string str;
+	std::ifstream ifstream(path);
+	if (ifstream.good()) {
+		std::getline(ifstream, str, '\0');
+	}
+	co_return str;
+}
 
-		virtual void execute(uint32_t const thread) override
-		{
-			Monke::log("Start loading...");
-			loadedWorld = World();
-			std::ifstream ifstream("world.yaml");
-			if (ifstream.good()) {
-				YAMLWorldSerializer s(loadedWorld);
-				std::string str;
-				std::getline(ifstream, str, '\0');
-				s.deserializeString(str);
-			}
-			Monke::log("Finished loading!");
-		}
-	private:
-		World& loadedWorld;
-	};
+static JobSystem::Task<void> loadWorldTask(World& loadedWorld)
+{
+	Monke::log("Start loading...");
+	std::string str = co_await readFileTask("world.yaml");
+	loadedWorld = World();
+	if (!str.empty()) {
+		YAMLWorldSerializer s(loadedWorld);
+		s.deserializeString(str);
+	}
+	Monke::log("Finished loading!");
+}
 
-	loadingWorkerTag = JobSystem::submit(LoadJob(loadedWorld));
+void Game::load()
+{
+	bLoading = true;
+	loadingWorkerTag = JobSystem::submitTask(loadWorldTask(loadedWorld), JobSystem::Priority::Background);
 }
 
 void Game::spawnBall()
 {
 	Vec2 scale = Vec2(0.2f, 0.2f);
 	Form form = Form::Circle;
-	Collider trashCollider = Collider(scale, form);
 	PhysicsBody trashSolidBody = PhysicsBody(0.2f, 0.5f, calcMomentOfIntertia(0.5, scale), 0.9f);
-	for (int i = 0; i < 10; i++) {
+	const size_t ballCount = 10;
+	std::vector<Vec2> scales;
+	std::vector<Vec4> colors;
+	std::vector<Vec2> positions;
+	for (size_t i = 0; i < ballCount; i++) {
 		float factor = (rand() % 1000) / 600.0f + 0.7f;
-		auto sscale = scale * factor;
-		form = Form::Circle;
-		trashCollider = Collider(sscale, form);
-
-		trashCollider.form = form;
-		Vec4 color = Vec4(rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, 1);
-		Vec2 position = { 20 + rand() % 1000 / 500.0f + 1.0f,60 + rand() % 1000 / 500.0f + 1.0f };
-		auto trash = world.create();
-		world.addComp(trash, Transform(position, RotaVec2(0)));
-		world.addComp(trash, Movement());
-		world.addComp(trash, trashCollider);
-		world.addComp(trash, trashSolidBody);
-		world.addComp(trash, Draw(color, sscale, 0.5f, form));
-		world.addComp(trash, Health(100));
-		world.addComp(trash, TextureLoadInfo{ "ressources/Dir.png" });
-		world.spawn(trash);
+		scales.push_back(scale * factor);
+		colors.push_back(Vec4(rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, 1));
+		positions.push_back({ 20 + rand() % 1000 / 500.0f + 1.0f,60 + rand() % 1000 / 500.0f + 1.0f });
+	}
+	const auto balls = world.createMany(ballCount);
+	world.addCompsWith<Transform>(balls, [&](size_t i) { return Transform(positions[i], RotaVec2(0)); });
+	world.addComps(balls, Movement());
+	world.addCompsWith<Collider>(balls, [&](size_t i) { return Collider(scales[i], form); });
+	world.addComps(balls, trashSolidBody);
+	world.addCompsWith<Draw>(balls, [&](size_t i) { return Draw(colors[i], scales[i], 0.5f, form); });
+	world.addComps(balls, Health(100), TextureLoadInfo{ "ressources/Dir.png" });
+	for (auto ball : balls) {
+		world.spawn(ball);
 	}
 }
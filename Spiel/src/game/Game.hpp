@@ -4,10 +4,12 @@
 #include <any>
 
 #include "../engine/collision/CollisionSystem.hpp"
+#include "../engine/collision/TransformHierarchySystem.hpp"
 #include "../engine/rendering/DefaultRenderer.hpp"
 #include "../engine/gui/GUIManager.hpp"
 
 #include "../engine/EngineCore.hpp"
+#include "../engine/entity/SystemScheduler.hpp"
 #include "World.hpp"
 using Coll = Collider;
 using Move = Movement;
@@ -40,8 +42,17 @@ public:
 
 	void cursorManipFunc();
 
+	/**
+	 * Structural changes the rendering needs, runs on the main thread before the rendering update is submitted.
+	 */
+	void prepareRendering();
 	void renderingUpdate();
 
+	/**
+	 * Registers the cached queries of the world, must be called again whenever the world is replaced.
+	 */
+	void registerQueries();
+
 	void reset();
 	void save();
 	void load();
@@ -53,6 +64,8 @@ public:
 	CursorManipData cursorData;
 	CollisionSystem collisionSystem{ world.submodule<COLLISION_SECM_COMPONENTS>() };
 	PhysicsSystem2 physicsSystem2;
+	TransformHierarchySystem transformHierarchySystem;
+	SystemScheduler<World> scriptScheduler;
 
 
 	// TEMP TODO REMOVE
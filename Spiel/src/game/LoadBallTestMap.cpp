@@ -156,30 +156,25 @@ void loadBallTestMap(Game& game)
 	Form form = Form::Circle;
 	Collider trashCollider = Collider(scale, form);
 	PhysicsBody trashSolidBody = PhysicsBody(0.2f, 0.5f, calcMomentOfIntertia(0.5, scale), 0.9f);
-	for (int i = 0; i < 10000; i++) {
-		//if (i % 2) {
-		//	form = Form::Rectangle;
-		//	scale = { 0.2f, 0.4f }; 
-		//	trashCollider = Collider(scale, form);
-		//}
-		//else {
-
+	const size_t trashCount = 10000;
+	std::vector<Vec2> trashScales;
+	std::vector<Vec4> trashColors;
+	std::vector<Vec2> trashPositions;
+	for (size_t i = 0; i < trashCount; i++) {
 		float factor = (rand() % 1000) / 600.0f + 0.7f;
-		auto sscale = scale * factor;
-		form = Form::Circle;
-		trashCollider = Collider(sscale, form);
-		//}
-		trashCollider.form = form;
-		Vec4 color = Vec4(rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, 1);
-		Vec2 position = { static_cast<float>(rand() % 1001 / 300.0f) * 4.6f + 5.5f, static_cast<float>(rand() % 1000 / 100.0f) * 4.6f + 5.5f };
-		auto trash = world.create();
-		world.addComp(trash, Transform(position, RotaVec2(0)));
-		world.addComp(trash, Movement());
-		world.addComp(trash, trashCollider);
-		world.addComp(trash, trashSolidBody);
-		world.addComp(trash, Draw(color, sscale, 0.5f, form));
-		world.addComp(trash, Health(100));
-		world.addComp(trash, TextureLoadInfo{ "ressources/Dir.png" });
+		trashScales.push_back(scale * factor);
+		trashColors.push_back(Vec4(rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, rand() % 1000 / 1000.0f, 1));
+		trashPositions.push_back({ static_cast<float>(rand() % 1001 / 300.0f) * 4.6f + 5.5f, static_cast<float>(rand() % 1000 / 100.0f) * 4.6f + 5.5f });
+	}
+	// the trash is created in bulk, so every storage grows once:
+	const auto trashEntities = world.createMany(trashCount);
+	world.addCompsWith<Transform>(trashEntities, [&](size_t i) { return Transform(trashPositions[i], RotaVec2(0)); });
+	world.addComps(trashEntities, Movement());
+	world.addCompsWith<Collider>(trashEntities, [&](size_t i) { return Collider(trashScales[i], form); });
+	world.addComps(trashEntities, trashSolidBody);
+	world.addCompsWith<Draw>(trashEntities, [&](size_t i) { return Draw(trashColors[i], trashScales[i], 0.5f, form); });
+	world.addComps(trashEntities, Health(100), TextureLoadInfo{ "ressources/Dir.png" });
+	for (auto trash : trashEntities) {
 		world.spawn(trash);
 	}
 
@@ -57,9 +57,10 @@ void particleScript(Game& game, EntityHandle me, ParticleScriptComp& data, float
 	
 	
 		if (relativeAge > 0.7f || data.collisionCount > 2) {
-			world.remComp<Collider>(me);
 			mov.velocity = Vec2(0, 0);
 			mov.angleVelocity *= 0.5f;
+			// moves the entity to another archetype, so mov and collider are invalid afterwards:
+			world.remComp<Collider>(me);
 		}
 	}
 
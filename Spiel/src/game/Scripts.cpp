@@ -5,7 +5,7 @@ void ageScript(Game& game, EntityHandle id, Age& data, float deltaTime)
 	data.curAge += deltaTime;
 
 	if (data.curAge > data.maxAge) {
-		game.world.destroy(id);
+		game.world.commands().destroy(id);
 	}
 }
 
@@ -29,8 +29,7 @@ void bulletScript(Game& game, EntityHandle me, Bullet& data, float deltaTime)
 		data.hitPoints = 0;
 	}
 	if (data.hitPoints <= 0) {
-		game.world.despawn(me);
-		game.world.destroy(me);
+		game.world.commands().destroy(me);
 	}
 }
 
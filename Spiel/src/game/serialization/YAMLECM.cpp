@@ -13,7 +13,7 @@ void YAMLEntitySerializer::serialize(YAML::Emitter& out, EntityHandle entity)
 	}
 	out << YAML::Key << "Entity" << YAML::Value << id;
 	
-	util::tuple_for_each(world.componentStorageTuple,
+	world.forEachComponentStorage(
 		[&](auto& componentStorage) {
 			using ComponentType = typename std::remove_reference<decltype(componentStorage.get(0))>::type;
 			if constexpr (isYAMLSerializable<ComponentType>()) {
@@ -34,7 +34,7 @@ bool YAMLEntitySerializer::deserialize(YAML::Node entityNode)
 	if (!uuidNode) return false;
 	
 	auto entity = world.create(uuidNode.as<UUID>());
-	util::tuple_for_each(world.componentStorageTuple,
+	world.forEachComponentStorage(
 		[&](auto& componentStorage) {
 			using ComponentType = typename std::remove_reference<decltype(componentStorage.get(0))>::type;
 			const std::string COMPONENT_NAME = typeid(ComponentType).name();
@@ -9,7 +9,7 @@ void YAMLWorldSerializer::serializeEntity(YAML::Emitter& out, EntityHandle entit
 	}
 	out << YAML::Key << "Entity" << YAML::Value << id;
 
-	util::tuple_for_each(world.componentStorageTuple, 
+	world.forEachComponentStorage(
 		[&](auto& componentStorage) {
 			using ComponentType = typename std::remove_reference<decltype(componentStorage.get(0))>::type;
 			if constexpr (isYAMLSerializable<ComponentType>()) {
@@ -30,7 +30,7 @@ bool YAMLWorldSerializer::deserializeEntity(const YAML::Node& entityNode)
 	if (!uuidNode) return false;
 
 	auto entity = world.create(uuidNode.as<UUID>());
-	util::tuple_for_each(world.componentStorageTuple,
+	world.forEachComponentStorage(
 		[&](auto& componentStorage) {
 			using ComponentType = typename std::remove_reference<decltype(componentStorage.get(0))>::type;
 			const std::string COMPONENT_NAME = typeid(ComponentType).name();
@@ -1,8 +1,14 @@
+// selects the app to build, only one of these may be defined, as every app has its own main:
 //#define MANDELBROT
 //#define BALLS2
 //#define GUITEST
+//#define STORAGE_BENCHMARK
 #define ANTS
 
+#if defined(MANDELBROT) + defined(BALLS2) + defined(GUITEST) + defined(STORAGE_BENCHMARK) + defined(ANTS) > 1
+#error "only one app may be selected in main.cpp"
+#endif
+
 #ifdef BALLS2
 
 #include "game/Game.hpp"
@@ -55,3 +61,22 @@ int main()
 }
 
 #endif
+
+#ifdef STORAGE_BENCHMARK
+
+#include <iostream>
+
+#include "engine/JobSystem.hpp"
+#include "benchmark/StorageBenchmark.hpp"
+
+int main()
+{
+	// the storage benchmarks need neither a window nor the JobSystem:
+	runStorageBenchmarks(std::cout);
+
+	// parallelEach runs on the JobSystem:
+	JobSystem::initialize();
+	runParallelEachBenchmarks(std::cout);
+}
+
+#endif